@@ -0,0 +1,47 @@
+// Clear-and-reuse cycles on a 1 MB string builder, with and without
+// `SB_NOZERO`. Each cycle fills the builder with 1 KB writes, then clears it.
+//
+//     cc -O2 -o sb_clear bench/sb_clear.c && ./sb_clear
+
+#define SB_IMPLEMENTATION
+#include "../src/sb.h"
+
+#include <time.h>
+
+#define CAP (1 << 20)
+#define CYCLES 2000
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Gets the mean time of a fill-and-clear cycle, in microseconds.
+static double run(const unsigned flags, const size_t fill) {
+	char chunk[1024];
+	memset(chunk, 'x', sizeof(chunk));
+	string_builder sb;
+	sb_init_flags(&sb, CAP, flags);
+	const double start = now();
+	for (int c = 0; c < CYCLES; c++) {
+		for (size_t n = 0; n < fill; n += sizeof(chunk)) {
+			sb_writen(&sb, chunk, sizeof(chunk));
+		}
+		sb_clear(&sb);
+	}
+	const double us = (now() - start) / CYCLES * 1e6;
+	sb_deinit(&sb);
+	return us;
+}
+
+int main(void) {
+	const size_t fills[] = { 1024, 64 * 1024, 1000 * 1024 };
+	printf("%-8s %12s %12s\n", "fill", "zeroing", "SB_NOZERO");
+	for (size_t i = 0; i < sizeof(fills) / sizeof(fills[0]); i++) {
+		const double zeroing = run(0, fills[i]);
+		const double nozero = run(SB_NOZERO, fills[i]);
+		printf("%5zu KB %9.2f us %9.2f us\n", fills[i] / 1024, zeroing, nozero);
+	}
+	return 0;
+}
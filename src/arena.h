@@ -4,9 +4,14 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdarg.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
 #ifndef ARENA_DEFAULT_ALIGNMENT
 #define ARENA_DEFAULT_ALIGNMENT (sizeof(void *) * 2)
 #endif /* ARENA_DEFAULT_ALIGNMENT */
@@ -90,13 +95,20 @@ static void *arena_aligned_realloc(arena *a, const size_t alignment, void *old_m
 		return arena_aligned_alloc(a, alignment, new_size);
 	} else if (a->mem <= old && old < a->mem + a->cap) {
 		if (a->mem+a->prev_offset == old) {
+			if (a->prev_offset+new_size > a->cap) {
+				errno = ENOMEM;
+				return NULL;
+			}
 			a->curr_offset = a->prev_offset+new_size;
 			if (new_size > old_size) {
-				memset(&a->mem[a->curr_offset], 0, new_size-old_size);
+				memset(&a->mem[a->prev_offset+old_size], 0, new_size-old_size);
 			}
 			return old;
 		} else {
 			void *new_mem = arena_aligned_alloc(a, alignment, new_size);
+			if (new_mem == NULL) {
+				return NULL;
+			}
 			size_t copy_size = old_size < new_size ? old_size : new_size;
 			memmove(new_mem, old, copy_size);
 			return new_mem;
@@ -220,6 +232,10 @@ typedef struct temp_arena {
 temp_arena temp_arena_begin(arena *a);
 void temp_arena_end(temp_arena temp);
 
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
 #ifdef ARENA_IMPLEMENTATION
 
 #include <stdio.h>
@@ -0,0 +1,78 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include "arena.h"
+
+/**
+ * Move-only owner of an arena and its backing memory. Moving transfers the
+ * memory without copying it, and `clone` makes the only kind of deep copy.
+ */
+class unique_arena {
+public:
+	/**
+	 * Creates an empty arena that owns no memory.
+	 */
+	unique_arena() noexcept { arena_init(&a_, nullptr, 0); }
+
+	/**
+	 * Creates an arena with `cap` bytes of backing memory. The arena is empty
+	 * (`capacity() == 0`) if the allocation fails.
+	 */
+	explicit unique_arena(size_t cap) noexcept {
+		void *mem = std::malloc(cap);
+		arena_init(&a_, mem, mem != nullptr ? cap : 0);
+	}
+
+	unique_arena(const unique_arena &) = delete;
+	unique_arena &operator=(const unique_arena &) = delete;
+
+	unique_arena(unique_arena &&other) noexcept : a_(other.a_) {
+		arena_init(&other.a_, nullptr, 0);
+	}
+
+	unique_arena &operator=(unique_arena &&other) noexcept {
+		if (this != &other) {
+			std::free(a_.mem);
+			a_ = other.a_;
+			arena_init(&other.a_, nullptr, 0);
+		}
+		return *this;
+	}
+
+	~unique_arena() { std::free(a_.mem); }
+
+	/**
+	 * Makes a deep copy with the same capacity and allocations. Pointers into
+	 * this arena are not rebased; the copy's allocations are at the same
+	 * offsets from `clone().get()->mem`.
+	 */
+	unique_arena clone() const {
+		unique_arena copy(a_.cap);
+		if (copy.a_.mem != nullptr) {
+			std::memcpy(copy.a_.mem, a_.mem, a_.curr_offset);
+			copy.a_.curr_offset = a_.curr_offset;
+			copy.a_.prev_offset = a_.prev_offset;
+		}
+		return copy;
+	}
+
+	arena *get() noexcept { return &a_; }
+	const arena *get() const noexcept { return &a_; }
+	arena &operator*() noexcept { return a_; }
+	arena *operator->() noexcept { return &a_; }
+
+	void *alloc(size_t size) noexcept { return arena_alloc(&a_, size); }
+	char *strdup(std::string_view s) noexcept { return arena_strndup(&a_, s.data(), s.size()); }
+	void reset() noexcept { arena_free(&a_); }
+	size_t used() const noexcept { return a_.curr_offset; }
+	size_t capacity() const noexcept { return a_.cap; }
+
+private:
+	arena a_; // The owned arena. `a_.mem` is owned too.
+};
+
+#endif // ARENA_HPP
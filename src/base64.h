@@ -0,0 +1,670 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sb.h"
+
+#define BASE64_URL   (1 << 0) // Use the URL- and filename-safe alphabet ("-_" instead of "+/").
+#define BASE64_NOPAD (1 << 1) // Omit the '=' padding when encoding.
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Gets the exact length of the base64 encoding of `n` bytes.
+ * @param n     The number of bytes.
+ * @param flags `BASE64_*` flags.
+ * @return The number of characters, without a terminator.
+ */
+size_t base64_encoded_len(size_t n, unsigned flags);
+
+/**
+ * Gets the exact length of the bytes that a base64 string decodes to, assuming
+ * the string is valid. Padding is optional.
+ * @param s The base64 string.
+ * @param n The number of characters.
+ * @return The number of decoded bytes.
+ */
+size_t base64_decoded_len(const char *s, size_t n);
+
+/**
+ * Encodes bytes as base64. Uses AVX2 or SSSE3 when the CPU supports them.
+ * @param dst   Destination with room for `base64_encoded_len(n, flags)` characters.
+ *              No terminator is written.
+ * @param src   The bytes to encode.
+ * @param n     The number of bytes.
+ * @param flags `BASE64_*` flags.
+ * @return The number of characters written.
+ */
+size_t base64_encode(char *dst, const void *src, size_t n, unsigned flags);
+
+/**
+ * Decodes base64. Padding is optional, and whitespace is not accepted.
+ * @param dst     Destination with room for `base64_decoded_len(src, n)` bytes.
+ * @param src     The base64 string.
+ * @param n       The number of characters.
+ * @param flags   `BASE64_URL` to decode the URL-safe alphabet.
+ * @param out_len Receives the number of bytes written.
+ * @return `true` on success; otherwise, `false` if `src` is not valid base64.
+ */
+bool base64_decode(void *dst, const char *src, size_t n, unsigned flags, size_t *out_len);
+
+/**
+ * Encodes bytes as lowercase hex.
+ * @param dst Destination with room for `2 * n` characters. No terminator is
+ *            written.
+ * @param src The bytes to encode.
+ * @param n   The number of bytes.
+ * @return The number of characters written.
+ */
+size_t hex_encode(char *dst, const void *src, size_t n);
+
+/**
+ * Decodes hex. Both cases are accepted.
+ * @param dst     Destination with room for `n / 2` bytes.
+ * @param src     The hex string.
+ * @param n       The number of characters, which must be even.
+ * @param out_len Receives the number of bytes written.
+ * @return `true` on success; otherwise, `false` if `src` is not valid hex.
+ */
+bool hex_decode(void *dst, const char *src, size_t n, size_t *out_len);
+
+/**
+ * Writes bytes to the string builder as base64.
+ * @param sb    String builder pointer.
+ * @param data  The bytes to encode.
+ * @param n     The number of bytes.
+ * @param flags `BASE64_*` flags.
+ * @return The number of characters written.
+ */
+size_t sb_write_base64(string_builder *sb, const void *data, size_t n, unsigned flags);
+
+/**
+ * Decodes base64 into the string builder. Nothing is written if the input is
+ * invalid.
+ * @param sb    String builder pointer.
+ * @param s     The base64 string.
+ * @param n     The number of characters.
+ * @param flags `BASE64_URL` to decode the URL-safe alphabet.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool sb_decode_base64(string_builder *sb, const char *s, size_t n, unsigned flags);
+
+/**
+ * Writes bytes to the string builder as lowercase hex.
+ * @param sb   String builder pointer.
+ * @param data The bytes to encode.
+ * @param n    The number of bytes.
+ * @return The number of characters written.
+ */
+size_t sb_write_hex(string_builder *sb, const void *data, size_t n);
+
+/**
+ * Decodes hex into the string builder. Nothing is written if the input is
+ * invalid.
+ * @param sb String builder pointer.
+ * @param s  The hex string.
+ * @param n  The number of characters.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool sb_decode_hex(string_builder *sb, const char *s, size_t n);
+
+#ifdef ARENA_H
+/**
+ * Encodes bytes as base64 into a null-terminated string allocated in an arena.
+ * @param a     Arena pointer.
+ * @param data  The bytes to encode.
+ * @param n     The number of bytes.
+ * @param flags `BASE64_*` flags.
+ * @return The encoded string, or `NULL` if the arena is full.
+ */
+char *arena_base64(arena *a, const void *data, size_t n, unsigned flags);
+
+/**
+ * Decodes base64 into bytes allocated in an arena.
+ * @param a       Arena pointer.
+ * @param s       The base64 string.
+ * @param n       The number of characters.
+ * @param flags   `BASE64_URL` to decode the URL-safe alphabet.
+ * @param out_len Receives the number of decoded bytes.
+ * @return The decoded bytes, or `NULL` if the input is invalid or the arena is
+ *         full.
+ */
+void *arena_base64_decode(arena *a, const char *s, size_t n, unsigned flags, size_t *out_len);
+
+/**
+ * Encodes bytes as lowercase hex into a null-terminated string allocated in an
+ * arena.
+ * @param a    Arena pointer.
+ * @param data The bytes to encode.
+ * @param n    The number of bytes.
+ * @return The encoded string, or `NULL` if the arena is full.
+ */
+char *arena_hex(arena *a, const void *data, size_t n);
+
+/**
+ * Decodes hex into bytes allocated in an arena.
+ * @param a       Arena pointer.
+ * @param s       The hex string.
+ * @param n       The number of characters.
+ * @param out_len Receives the number of decoded bytes.
+ * @return The decoded bytes, or `NULL` if the input is invalid or the arena is
+ *         full.
+ */
+void *arena_hex_decode(arena *a, const char *s, size_t n, size_t *out_len);
+#endif // ARENA_H
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef BASE64_IMPLEMENTATION
+
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_X86
+#include <immintrin.h>
+#endif // x86 && (GCC || Clang)
+
+static const char base64_std[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base64_url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static const char hex_digits[] = "0123456789abcdef";
+
+static int base64_value(const unsigned char c, const unsigned flags) {
+	if (c >= 'A' && c <= 'Z') { return c - 'A'; }
+	if (c >= 'a' && c <= 'z') { return c - 'a' + 26; }
+	if (c >= '0' && c <= '9') { return c - '0' + 52; }
+	if (c == (flags & BASE64_URL ? '-' : '+')) { return 62; }
+	if (c == (flags & BASE64_URL ? '_' : '/')) { return 63; }
+	return -1;
+}
+
+static int hex_value(const unsigned char c) {
+	if (c >= '0' && c <= '9') { return c - '0'; }
+	if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+	if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+	return -1;
+}
+
+#ifdef BASE64_X86
+// The SIMD kernels below process whole blocks and return the number of input
+// bytes they consumed; the scalar code finishes the rest. Encoding follows
+// Muła and Lemire, "Faster Base64 Encoding and Decoding Using AVX2
+// Instructions" (2018). Decoding classifies characters by range, so both
+// alphabets share one kernel.
+
+#define BASE64_ENC_SHUF 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1
+#define BASE64_ENC_LUT(c62, c63) \
+	'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, \
+	'0' - 52, '0' - 52, '0' - 52, (c62) - 62, (c63) - 63, 'A', 0, 0
+#define BASE64_DEC_SHUF 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+// Splits each 3-byte group in the low 12 bytes into four 6-bit indices and
+// maps them to ASCII.
+__attribute__((target("ssse3")))
+static inline __m128i base64_enc_ssse3(__m128i in, const __m128i lut) {
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(BASE64_ENC_SHUF));
+	const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	const __m128i idx = _mm_or_si128(t1, t3);
+	// 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+	__m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+	r = _mm_or_si128(r, _mm_and_si128(less, _mm_set1_epi8(13)));
+	return _mm_add_epi8(_mm_shuffle_epi8(lut, r), idx);
+}
+
+// Gets a mask of the bytes in [lo, hi].
+__attribute__((target("ssse3")))
+static inline __m128i base64_range_ssse3(const __m128i in, const char lo, const char hi) {
+	return _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8((char)(lo - 1))),
+		_mm_cmpgt_epi8(_mm_set1_epi8((char)(hi + 1)), in));
+}
+
+// Maps 16 characters to 12 bytes in the low bytes of the result, and sets
+// `ok` to a mask of the characters in the alphabet.
+__attribute__((target("ssse3")))
+static inline __m128i base64_dec_ssse3(__m128i in, const char c62, const char c63, __m128i *ok) {
+	const __m128i upper = base64_range_ssse3(in, 'A', 'Z');
+	const __m128i lower = base64_range_ssse3(in, 'a', 'z');
+	const __m128i digit = base64_range_ssse3(in, '0', '9');
+	const __m128i e62 = _mm_cmpeq_epi8(in, _mm_set1_epi8(c62));
+	const __m128i e63 = _mm_cmpeq_epi8(in, _mm_set1_epi8(c63));
+	__m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+	shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+	shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+	shift = _mm_or_si128(shift, _mm_and_si128(e62, _mm_set1_epi8((char)(62 - c62))));
+	shift = _mm_or_si128(shift, _mm_and_si128(e63, _mm_set1_epi8((char)(63 - c63))));
+	*ok = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(e62, e63)));
+	in = _mm_add_epi8(in, shift);
+	// Merge four 6-bit values into three big-endian bytes per 32-bit lane.
+	in = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+	in = _mm_madd_epi16(in, _mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(in, _mm_setr_epi8(BASE64_DEC_SHUF));
+}
+
+// Maps 16 hex characters to 8 bytes in the low byte of each 16-bit lane, and
+// sets `ok` to a mask of the hex characters.
+__attribute__((target("ssse3")))
+static inline __m128i hex_dec_ssse3(__m128i in, __m128i *ok) {
+	const __m128i digit = base64_range_ssse3(in, '0', '9');
+	const __m128i lower = base64_range_ssse3(in, 'a', 'f');
+	const __m128i upper = base64_range_ssse3(in, 'A', 'F');
+	__m128i shift = _mm_and_si128(digit, _mm_set1_epi8(-'0'));
+	shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(10 - 'a')));
+	shift = _mm_or_si128(shift, _mm_and_si128(upper, _mm_set1_epi8(10 - 'A')));
+	*ok = _mm_or_si128(digit, _mm_or_si128(lower, upper));
+	return _mm_maddubs_epi16(_mm_add_epi8(in, shift), _mm_set1_epi16(0x0110));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i base64_enc_avx2(__m256i in, const __m256i lut) {
+	in = _mm256_shuffle_epi8(in, _mm256_set_epi8(BASE64_ENC_SHUF, BASE64_ENC_SHUF));
+	const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+	const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+	const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	const __m256i idx = _mm256_or_si256(t1, t3);
+	__m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+	const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+	r = _mm256_or_si256(r, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+	return _mm256_add_epi8(_mm256_shuffle_epi8(lut, r), idx);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i base64_range_avx2(const __m256i in, const char lo, const char hi) {
+	return _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8((char)(lo - 1))),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8((char)(hi + 1)), in));
+}
+
+// Maps 32 characters to 12 bytes in the low bytes of each 128-bit lane.
+__attribute__((target("avx2")))
+static inline __m256i base64_dec_avx2(__m256i in, const char c62, const char c63, __m256i *ok) {
+	const __m256i upper = base64_range_avx2(in, 'A', 'Z');
+	const __m256i lower = base64_range_avx2(in, 'a', 'z');
+	const __m256i digit = base64_range_avx2(in, '0', '9');
+	const __m256i e62 = _mm256_cmpeq_epi8(in, _mm256_set1_epi8(c62));
+	const __m256i e63 = _mm256_cmpeq_epi8(in, _mm256_set1_epi8(c63));
+	__m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(e62, _mm256_set1_epi8((char)(62 - c62))));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(e63, _mm256_set1_epi8((char)(63 - c63))));
+	*ok = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(e62, e63)));
+	in = _mm256_add_epi8(in, shift);
+	in = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+	in = _mm256_madd_epi16(in, _mm256_set1_epi32(0x00011000));
+	return _mm256_shuffle_epi8(in, _mm256_setr_epi8(BASE64_DEC_SHUF, BASE64_DEC_SHUF));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_dec_avx2(__m256i in, __m256i *ok) {
+	const __m256i digit = base64_range_avx2(in, '0', '9');
+	const __m256i lower = base64_range_avx2(in, 'a', 'f');
+	const __m256i upper = base64_range_avx2(in, 'A', 'F');
+	__m256i shift = _mm256_and_si256(digit, _mm256_set1_epi8(-'0'));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(10 - 'a')));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(upper, _mm256_set1_epi8(10 - 'A')));
+	*ok = _mm256_or_si256(digit, _mm256_or_si256(lower, upper));
+	return _mm256_maddubs_epi16(_mm256_add_epi8(in, shift), _mm256_set1_epi16(0x0110));
+}
+
+__attribute__((target("ssse3")))
+static size_t base64_encode_ssse3(char *dst, const unsigned char *src, const size_t n, const unsigned flags) {
+	const __m128i lut = flags & BASE64_URL
+		? _mm_setr_epi8(BASE64_ENC_LUT('-', '_'))
+		: _mm_setr_epi8(BASE64_ENC_LUT('+', '/'));
+	size_t i = 0;
+	// Each step reads 16 bytes but consumes 12.
+	for (; i + 16 <= n; i += 12, dst += 16) {
+		const __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)dst, base64_enc_ssse3(in, lut));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t base64_encode_avx2(char *dst, const unsigned char *src, const size_t n, const unsigned flags) {
+	const __m256i lut = flags & BASE64_URL
+		? _mm256_setr_epi8(BASE64_ENC_LUT('-', '_'), BASE64_ENC_LUT('-', '_'))
+		: _mm256_setr_epi8(BASE64_ENC_LUT('+', '/'), BASE64_ENC_LUT('+', '/'));
+	size_t i = 0;
+	// Each lane reads 16 bytes but consumes 12.
+	for (; i + 28 <= n; i += 24, dst += 32) {
+		const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + i))),
+			_mm_loadu_si128((const __m128i *)(src + i + 12)), 1);
+		_mm256_storeu_si256((__m256i *)dst, base64_enc_avx2(in, lut));
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t base64_decode_ssse3(unsigned char *dst, const char *src, const size_t n, const unsigned flags) {
+	const char c62 = flags & BASE64_URL ? '-' : '+';
+	const char c63 = flags & BASE64_URL ? '_' : '/';
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16, dst += 12) {
+		__m128i ok;
+		const __m128i out = base64_dec_ssse3(_mm_loadu_si128((const __m128i *)(src + i)), c62, c63, &ok);
+		if (_mm_movemask_epi8(ok) != 0xFFFF) { break; }
+		_mm_storel_epi64((__m128i *)dst, out);
+		const uint32_t last = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+		memcpy(dst + 8, &last, 4);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t base64_decode_avx2(unsigned char *dst, const char *src, const size_t n, const unsigned flags) {
+	const char c62 = flags & BASE64_URL ? '-' : '+';
+	const char c63 = flags & BASE64_URL ? '_' : '/';
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32, dst += 24) {
+		__m256i ok;
+		__m256i out = base64_dec_avx2(_mm256_loadu_si256((const __m256i *)(src + i)), c62, c63, &ok);
+		if ((uint32_t)_mm256_movemask_epi8(ok) != 0xFFFFFFFF) { break; }
+		// Each lane holds 12 bytes; move them next to each other.
+		out = _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(out));
+		_mm_storel_epi64((__m128i *)(dst + 16), _mm256_extracti128_si256(out, 1));
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t hex_encode_ssse3(char *dst, const unsigned char *src, const size_t n) {
+	const __m128i lut = _mm_loadu_si128((const __m128i *)hex_digits);
+	const __m128i nib = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16, dst += 32) {
+		const __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(in, 4), nib));
+		const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(in, nib));
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_encode_avx2(char *dst, const unsigned char *src, const size_t n) {
+	const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)hex_digits));
+	const __m256i nib = _mm256_set1_epi8(0x0F);
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32, dst += 64) {
+		const __m256i in = _mm256_loadu_si256((const __m256i *)(src + i));
+		const __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(in, 4), nib));
+		const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(in, nib));
+		const __m256i a = _mm256_unpacklo_epi8(hi, lo);
+		const __m256i b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst + 32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t hex_decode_ssse3(unsigned char *dst, const char *src, const size_t n) {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32, dst += 16) {
+		__m128i ok_a, ok_b;
+		const __m128i a = hex_dec_ssse3(_mm_loadu_si128((const __m128i *)(src + i)), &ok_a);
+		const __m128i b = hex_dec_ssse3(_mm_loadu_si128((const __m128i *)(src + i + 16)), &ok_b);
+		if (_mm_movemask_epi8(_mm_and_si128(ok_a, ok_b)) != 0xFFFF) { break; }
+		_mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(a, b));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_decode_avx2(unsigned char *dst, const char *src, const size_t n) {
+	size_t i = 0;
+	for (; i + 64 <= n; i += 64, dst += 32) {
+		__m256i ok_a, ok_b;
+		const __m256i a = hex_dec_avx2(_mm256_loadu_si256((const __m256i *)(src + i)), &ok_a);
+		const __m256i b = hex_dec_avx2(_mm256_loadu_si256((const __m256i *)(src + i + 32)), &ok_b);
+		if ((uint32_t)_mm256_movemask_epi8(_mm256_and_si256(ok_a, ok_b)) != 0xFFFFFFFF) { break; }
+		// Packing works per lane, so restore the order of the 64-bit halves.
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+		_mm256_storeu_si256((__m256i *)dst, packed);
+	}
+	return i;
+}
+#endif // BASE64_X86
+
+size_t base64_encoded_len(size_t n, unsigned flags) {
+	if (flags & BASE64_NOPAD) {
+		return n / 3 * 4 + (n % 3 ? n % 3 + 1 : 0);
+	}
+	return (n + 2) / 3 * 4;
+}
+
+size_t base64_decoded_len(const char *s, size_t n) {
+	for (int k = 0; k < 2 && n > 0 && s[n-1] == '='; k++) {
+		n--;
+	}
+	return n / 4 * 3 + (n % 4 > 1 ? n % 4 - 1 : 0);
+}
+
+size_t base64_encode(char *dst, const void *src, size_t n, unsigned flags) {
+	const unsigned char *s = (const unsigned char *)src;
+	const char *abc = flags & BASE64_URL ? base64_url : base64_std;
+	size_t i = 0;
+	char *o = dst;
+#ifdef BASE64_X86
+	if (__builtin_cpu_supports("avx2")) {
+		i = base64_encode_avx2(o, s, n, flags);
+		o += i / 3 * 4;
+	}
+	if (__builtin_cpu_supports("ssse3")) {
+		const size_t m = base64_encode_ssse3(o, s + i, n - i, flags);
+		i += m;
+		o += m / 3 * 4;
+	}
+#endif // BASE64_X86
+	for (; i + 3 <= n; i += 3) {
+		const uint32_t v = (uint32_t)s[i] << 16 | (uint32_t)s[i+1] << 8 | s[i+2];
+		*o++ = abc[v >> 18];
+		*o++ = abc[(v >> 12) & 0x3F];
+		*o++ = abc[(v >> 6) & 0x3F];
+		*o++ = abc[v & 0x3F];
+	}
+	if (i < n) {
+		const uint32_t v = (uint32_t)s[i] << 16 | (i + 1 < n ? (uint32_t)s[i+1] << 8 : 0);
+		*o++ = abc[v >> 18];
+		*o++ = abc[(v >> 12) & 0x3F];
+		if (i + 1 < n) {
+			*o++ = abc[(v >> 6) & 0x3F];
+		} else if (!(flags & BASE64_NOPAD)) {
+			*o++ = '=';
+		}
+		if (!(flags & BASE64_NOPAD)) {
+			*o++ = '=';
+		}
+	}
+	return (size_t)(o - dst);
+}
+
+bool base64_decode(void *dst, const char *src, size_t n, unsigned flags, size_t *out_len) {
+	const size_t total = n;
+	for (int k = 0; k < 2 && n > 0 && src[n-1] == '='; k++) {
+		n--;
+	}
+	// Padding, if present, must complete the last group.
+	if ((n != total && total % 4 != 0) || n % 4 == 1) {
+		return false;
+	}
+	unsigned char *o = (unsigned char *)dst;
+	size_t i = 0;
+#ifdef BASE64_X86
+	if (__builtin_cpu_supports("avx2")) {
+		i = base64_decode_avx2(o, src, n, flags);
+		o += i / 4 * 3;
+	}
+	if (__builtin_cpu_supports("ssse3")) {
+		const size_t m = base64_decode_ssse3(o, src + i, n - i, flags);
+		i += m;
+		o += m / 4 * 3;
+	}
+#endif // BASE64_X86
+	for (; i < n; i += 4) {
+		const size_t m = n - i < 4 ? n - i : 4;
+		uint32_t v = 0;
+		for (size_t k = 0; k < 4; k++) {
+			int d = 0;
+			if (k < m) {
+				d = base64_value((unsigned char)src[i+k], flags);
+				if (d < 0) { return false; }
+			}
+			v = v << 6 | (uint32_t)d;
+		}
+		*o++ = (unsigned char)(v >> 16);
+		if (m > 2) { *o++ = (unsigned char)(v >> 8); }
+		if (m > 3) { *o++ = (unsigned char)v; }
+	}
+	*out_len = (size_t)(o - (unsigned char *)dst);
+	return true;
+}
+
+size_t hex_encode(char *dst, const void *src, size_t n) {
+	const unsigned char *s = (const unsigned char *)src;
+	size_t i = 0;
+#ifdef BASE64_X86
+	if (__builtin_cpu_supports("avx2")) {
+		i = hex_encode_avx2(dst, s, n);
+	}
+	if (__builtin_cpu_supports("ssse3")) {
+		i += hex_encode_ssse3(dst + 2 * i, s + i, n - i);
+	}
+#endif // BASE64_X86
+	for (; i < n; i++) {
+		dst[2*i] = hex_digits[s[i] >> 4];
+		dst[2*i+1] = hex_digits[s[i] & 0x0F];
+	}
+	return 2 * n;
+}
+
+bool hex_decode(void *dst, const char *src, size_t n, size_t *out_len) {
+	if (n % 2 != 0) {
+		return false;
+	}
+	unsigned char *o = (unsigned char *)dst;
+	size_t i = 0;
+#ifdef BASE64_X86
+	if (__builtin_cpu_supports("avx2")) {
+		i = hex_decode_avx2(o, src, n);
+	}
+	if (__builtin_cpu_supports("ssse3")) {
+		i += hex_decode_ssse3(o + i / 2, src + i, n - i);
+	}
+#endif // BASE64_X86
+	for (; i < n; i += 2) {
+		const int hi = hex_value((unsigned char)src[i]);
+		const int lo = hex_value((unsigned char)src[i+1]);
+		if (hi < 0 || lo < 0) {
+			return false;
+		}
+		o[i/2] = (unsigned char)(hi << 4 | lo);
+	}
+	*out_len = n / 2;
+	return true;
+}
+
+size_t sb_write_base64(string_builder *sb, const void *data, size_t n, unsigned flags) {
+	char *dst = sb_reserve(sb, base64_encoded_len(n, flags));
+	if (dst == NULL) {
+		return 0;
+	}
+	const size_t len = base64_encode(dst, data, n, flags);
+	sb_advance(sb, len);
+	return len;
+}
+
+bool sb_decode_base64(string_builder *sb, const char *s, size_t n, unsigned flags) {
+	const size_t max = base64_decoded_len(s, n);
+	char *dst = sb_reserve(sb, max);
+	if (dst == NULL) {
+		return false;
+	}
+	size_t len;
+	if (!base64_decode(dst, s, n, flags, &len)) {
+		// Restore the terminator and the zeroed tail that the partial output
+		// overwrote.
+		memset(dst, 0, sb->flags & SB_NOZERO ? 1 : max);
+		return false;
+	}
+	sb_advance(sb, len);
+	return true;
+}
+
+size_t sb_write_hex(string_builder *sb, const void *data, size_t n) {
+	char *dst = sb_reserve(sb, 2 * n);
+	if (dst == NULL) {
+		return 0;
+	}
+	const size_t len = hex_encode(dst, data, n);
+	sb_advance(sb, len);
+	return len;
+}
+
+bool sb_decode_hex(string_builder *sb, const char *s, size_t n) {
+	char *dst = sb_reserve(sb, n / 2);
+	if (dst == NULL) {
+		return false;
+	}
+	size_t len;
+	if (!hex_decode(dst, s, n, &len)) {
+		memset(dst, 0, sb->flags & SB_NOZERO ? 1 : n / 2);
+		return false;
+	}
+	sb_advance(sb, len);
+	return true;
+}
+
+#ifdef ARENA_H
+char *arena_base64(arena *a, const void *data, size_t n, unsigned flags) {
+	char *dst = (char *)arena_alloc(a, base64_encoded_len(n, flags) + 1);
+	if (dst == NULL) {
+		return NULL;
+	}
+	dst[base64_encode(dst, data, n, flags)] = '\0';
+	return dst;
+}
+
+void *arena_base64_decode(arena *a, const char *s, size_t n, unsigned flags, size_t *out_len) {
+	const size_t len = base64_decoded_len(s, n);
+	void *dst = arena_alloc(a, len > 0 ? len : 1);
+	if (dst == NULL || !base64_decode(dst, s, n, flags, out_len)) {
+		return NULL;
+	}
+	return dst;
+}
+
+char *arena_hex(arena *a, const void *data, size_t n) {
+	char *dst = (char *)arena_alloc(a, 2 * n + 1);
+	if (dst == NULL) {
+		return NULL;
+	}
+	dst[hex_encode(dst, data, n)] = '\0';
+	return dst;
+}
+
+void *arena_hex_decode(arena *a, const char *s, size_t n, size_t *out_len) {
+	void *dst = arena_alloc(a, n / 2 > 0 ? n / 2 : 1);
+	if (dst == NULL || !hex_decode(dst, s, n, out_len)) {
+		return NULL;
+	}
+	return dst;
+}
+#endif // ARENA_H
+
+#endif // BASE64_IMPLEMENTATION
+
+#endif // BASE64_H
@@ -0,0 +1,478 @@
+#ifndef BB_H
+#define BB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sb.h"
+
+// The most bytes a LEB128 varint of a 64-bit integer takes.
+#define BB_VARINT_MAX 10
+
+/**
+ * Byte orders of fixed-width fields.
+ */
+enum {
+	BB_LE = 0, // Little-endian.
+	BB_BE = 1, // Big-endian.
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Binary messages are built in a `string_builder`, so they have the same
+// growth and allocator backends (heap, mapping, arena, custom allocator or
+// sink). Fields are written either with the checked `bb_write_*` functions,
+// or by reserving room for several fields with `bb_reserve`, writing them
+// with the unchecked `bb_put_*` functions and committing with `bb_commit`,
+// which pays for a single bounds check.
+
+static inline uint8_t *bb_put_u8(uint8_t *p, uint8_t v) {
+	*p = v;
+	return p + 1;
+}
+
+static inline uint8_t *bb_put_u16le(uint8_t *p, uint16_t v) {
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	return p + 2;
+}
+
+static inline uint8_t *bb_put_u16be(uint8_t *p, uint16_t v) {
+	p[0] = (uint8_t)(v >> 8);
+	p[1] = (uint8_t)v;
+	return p + 2;
+}
+
+static inline uint8_t *bb_put_u32le(uint8_t *p, uint32_t v) {
+	for (int i = 0; i < 4; i++) {
+		p[i] = (uint8_t)(v >> (8 * i));
+	}
+	return p + 4;
+}
+
+static inline uint8_t *bb_put_u32be(uint8_t *p, uint32_t v) {
+	for (int i = 0; i < 4; i++) {
+		p[i] = (uint8_t)(v >> (24 - 8 * i));
+	}
+	return p + 4;
+}
+
+static inline uint8_t *bb_put_u64le(uint8_t *p, uint64_t v) {
+	for (int i = 0; i < 8; i++) {
+		p[i] = (uint8_t)(v >> (8 * i));
+	}
+	return p + 8;
+}
+
+static inline uint8_t *bb_put_u64be(uint8_t *p, uint64_t v) {
+	for (int i = 0; i < 8; i++) {
+		p[i] = (uint8_t)(v >> (56 - 8 * i));
+	}
+	return p + 8;
+}
+
+static inline uint8_t *bb_put_f32le(uint8_t *p, float v) {
+	uint32_t u;
+	memcpy(&u, &v, 4);
+	return bb_put_u32le(p, u);
+}
+
+static inline uint8_t *bb_put_f64le(uint8_t *p, double v) {
+	uint64_t u;
+	memcpy(&u, &v, 8);
+	return bb_put_u64le(p, u);
+}
+
+/**
+ * Writes an unsigned LEB128 varint of at most `BB_VARINT_MAX` bytes.
+ * @param p Where to write.
+ * @param v The integer.
+ * @return The end of the varint.
+ */
+static inline uint8_t *bb_put_varint(uint8_t *p, uint64_t v) {
+	while (v >= 0x80) {
+		*p++ = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+// Maps signed integers to unsigned ones so small magnitudes stay small: 0, -1, 1, -2 -> 0, 1, 2, 3.
+static inline uint64_t bb_zigzag(int64_t v) {
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t bb_unzigzag(uint64_t v) {
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline uint8_t *bb_put_svarint(uint8_t *p, int64_t v) {
+	return bb_put_varint(p, bb_zigzag(v));
+}
+
+static inline uint8_t *bb_put_bytes(uint8_t *p, const void *src, size_t n) {
+	if (n > 0) {
+		memcpy(p, src, n);
+	}
+	return p + n;
+}
+
+/**
+ * Gets the number of bytes in the varint of `v`.
+ * @param v The integer.
+ * @return The number of bytes, from 1 to `BB_VARINT_MAX`.
+ */
+static inline size_t bb_varint_len(uint64_t v) {
+	size_t n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+/**
+ * Makes room for `n` more bytes, to be written with the `bb_put_*` functions.
+ * @param sb String builder pointer.
+ * @param n  The most bytes that will be written.
+ * @return Where to write, or `NULL` on failure.
+ */
+static inline uint8_t *bb_reserve(string_builder *sb, size_t n) {
+	return (uint8_t *)sb_reserve(sb, n);
+}
+
+/**
+ * Commits the bytes written since `bb_reserve`.
+ * @param sb  String builder pointer.
+ * @param end The end of the written bytes, as returned by the last `bb_put_*`.
+ */
+static inline void bb_commit(string_builder *sb, uint8_t *end) {
+	sb_advance(sb, (size_t)((char *)end - (sb->buf + sb->len)));
+}
+
+/**
+ * Writes a fixed-width unsigned integer.
+ * @param sb    String builder pointer.
+ * @param v     The integer. It must fit in `width` bytes.
+ * @param width The width in bytes: 1, 2, 4 or 8.
+ * @param order `BB_LE` or `BB_BE`.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool bb_write_uint(string_builder *sb, uint64_t v, unsigned width, int order);
+
+/**
+ * Writes an unsigned LEB128 varint.
+ * @param sb String builder pointer.
+ * @param v  The integer.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool bb_write_varint(string_builder *sb, uint64_t v);
+
+/**
+ * Writes a zigzag-encoded signed LEB128 varint.
+ * @param sb String builder pointer.
+ * @param v  The integer.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool bb_write_svarint(string_builder *sb, int64_t v);
+
+/**
+ * Writes a blob prefixed with its length as a varint.
+ * @param sb String builder pointer.
+ * @param s  The bytes.
+ * @param n  The number of bytes.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool bb_write_blob(string_builder *sb, const void *s, size_t n);
+
+/**
+ * A length field reserved by `bb_begin_len`.
+ */
+typedef struct bb_len {
+	size_t at;        // The offset of the field, or `SIZE_MAX` if it could not be reserved.
+	unsigned width;   // The width in bytes.
+	unsigned flushes; // The builder's flush count when the field was reserved.
+} bb_len;
+
+/**
+ * Reserves a fixed-width length field, to be filled in by `bb_end_len` once
+ * the bytes it covers have been written. On a builder with a sink, the field
+ * and those bytes must fit in the buffer, since a flush in between sends the
+ * field out unfilled.
+ * @param sb    String builder pointer.
+ * @param width The width in bytes: 1, 2, 4 or 8.
+ * @return The field, whose `at` is `SIZE_MAX` on failure.
+ */
+bb_len bb_begin_len(string_builder *sb, unsigned width);
+
+/**
+ * Fills in a length field with the number of bytes written after it.
+ * @param sb    String builder pointer.
+ * @param field The field returned by `bb_begin_len`.
+ * @param order `BB_LE` or `BB_BE`.
+ * @return `true` on success; otherwise, `false` if the length does not fit or
+ *         the builder was flushed since the field was reserved.
+ */
+bool bb_end_len(string_builder *sb, const bb_len *field, int order);
+
+/**
+ * Overwrites a fixed-width unsigned integer already in the builder. If
+ * hashing is enabled and the integer was already hashed, the contents are
+ * rehashed, which fails once the hash covers flushed bytes.
+ * @param sb    String builder pointer.
+ * @param at    The offset of the integer.
+ * @param v     The integer.
+ * @param width The width in bytes: 1, 2, 4 or 8.
+ * @param order `BB_LE` or `BB_BE`.
+ * @return `true` on success; otherwise, `false` and the builder is unchanged.
+ */
+bool bb_patch(string_builder *sb, size_t at, uint64_t v, unsigned width, int order);
+
+/**
+ * Zero-copy reader of binary messages. Reads past the end or malformed
+ * varints set `err` and return zero (0) or an empty slice, so a message can
+ * be decoded without checking each field and validated once at the end.
+ */
+typedef struct bb_reader {
+	const uint8_t *p;   // The next byte.
+	const uint8_t *end; // The end of the input.
+	bool err;           // Whether a read failed.
+} bb_reader;
+
+/**
+ * Initializes a reader.
+ * @param r Reader pointer.
+ * @param s The input, e.g. an arena allocation or `sb_as_slice(&sb)`. It must
+ *          outlive the slices read from it.
+ */
+void bb_reader_init(bb_reader *r, sb_slice s);
+
+/**
+ * Reads a fixed-width unsigned integer.
+ * @param r     Reader pointer.
+ * @param width The width in bytes: 1, 2, 4 or 8.
+ * @param order `BB_LE` or `BB_BE`.
+ * @return The integer.
+ */
+uint64_t bb_read_uint(bb_reader *r, unsigned width, int order);
+
+/**
+ * Reads a little-endian IEEE 754 single.
+ * @param r Reader pointer.
+ * @return The float.
+ */
+float bb_read_f32le(bb_reader *r);
+
+/**
+ * Reads a little-endian IEEE 754 double.
+ * @param r Reader pointer.
+ * @return The double.
+ */
+double bb_read_f64le(bb_reader *r);
+
+/**
+ * Reads an unsigned LEB128 varint.
+ * @param r Reader pointer.
+ * @return The integer.
+ */
+uint64_t bb_read_varint(bb_reader *r);
+
+/**
+ * Reads a zigzag-encoded signed LEB128 varint.
+ * @param r Reader pointer.
+ * @return The integer.
+ */
+int64_t bb_read_svarint(bb_reader *r);
+
+/**
+ * Reads `n` bytes without copying them.
+ * @param r Reader pointer.
+ * @param n The number of bytes.
+ * @return The bytes, which point into the input.
+ */
+sb_slice bb_read_bytes(bb_reader *r, size_t n);
+
+/**
+ * Reads a blob prefixed with its length as a varint, without copying it.
+ * @param r Reader pointer.
+ * @return The blob, which points into the input.
+ */
+sb_slice bb_read_blob(bb_reader *r);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef BB_IMPLEMENTATION
+
+static uint8_t *bb_put_uint(uint8_t *p, const uint64_t v, const unsigned width, const int order) {
+	for (unsigned i = 0; i < width; i++) {
+		const unsigned shift = 8 * (order == BB_BE ? width - 1 - i : i);
+		p[i] = (uint8_t)(v >> shift);
+	}
+	return p + width;
+}
+
+bool bb_write_uint(string_builder *sb, uint64_t v, unsigned width, int order) {
+	uint8_t *p = bb_reserve(sb, width);
+	if (p == NULL) { return false; }
+	switch (width) {
+	case 1: p = bb_put_u8(p, (uint8_t)v); break;
+	case 2: p = order == BB_BE ? bb_put_u16be(p, (uint16_t)v) : bb_put_u16le(p, (uint16_t)v); break;
+	case 4: p = order == BB_BE ? bb_put_u32be(p, (uint32_t)v) : bb_put_u32le(p, (uint32_t)v); break;
+	case 8: p = order == BB_BE ? bb_put_u64be(p, v) : bb_put_u64le(p, v); break;
+	default: return false;
+	}
+	bb_commit(sb, p);
+	return true;
+}
+
+bool bb_write_varint(string_builder *sb, uint64_t v) {
+	uint8_t *p = bb_reserve(sb, BB_VARINT_MAX);
+	if (p == NULL) { return false; }
+	bb_commit(sb, bb_put_varint(p, v));
+	return true;
+}
+
+bool bb_write_svarint(string_builder *sb, int64_t v) {
+	return bb_write_varint(sb, bb_zigzag(v));
+}
+
+bool bb_write_blob(string_builder *sb, const void *s, size_t n) {
+	uint8_t *p = bb_reserve(sb, BB_VARINT_MAX + n);
+	if (p == NULL) { return false; }
+	p = bb_put_varint(p, n);
+	bb_commit(sb, bb_put_bytes(p, s, n));
+	return true;
+}
+
+bb_len bb_begin_len(string_builder *sb, unsigned width) {
+	bb_len field = { SIZE_MAX, width, 0 };
+	if (width != 1 && width != 2 && width != 4 && width != 8) { return field; }
+	uint8_t *p = bb_reserve(sb, width);
+	if (p == NULL) { return field; }
+	// Reserving may flush, so the count is taken after it.
+	field.at = sb->len;
+	field.flushes = sb->flushes;
+	memset(p, 0, width);
+	bb_commit(sb, p + width);
+	return field;
+}
+
+bool bb_end_len(string_builder *sb, const bb_len *field, int order) {
+	// After a flush the offset points at other bytes.
+	if (field->at == SIZE_MAX || field->flushes != sb->flushes || field->at + field->width > sb->len) {
+		return false;
+	}
+	const size_t at = field->at;
+	const unsigned width = field->width;
+	const uint64_t len = (uint64_t)(sb->len - at - width);
+	if (width < 8 && len >> (8 * width) != 0) { return false; }
+	return bb_patch(sb, at, len, width, order);
+}
+
+bool bb_patch(string_builder *sb, size_t at, uint64_t v, unsigned width, int order) {
+	if ((width != 1 && width != 2 && width != 4 && width != 8) || at > sb->len || width > sb->len - at) {
+		return false;
+	}
+	// Appended bytes are hashed lazily, so recent fields can be patched for free.
+	const bool rehash = sb->hash != NULL && at < sb->hash->pos;
+	// Rehashing starts from the buffer, so it would drop flushed bytes.
+	if (rehash && sb->hash->total != sb->hash->pos) { return false; }
+	bb_put_uint((uint8_t *)sb->buf + at, v, width, order);
+	if (rehash) {
+		sb_hash_sync(sb);
+	}
+	return true;
+}
+
+void bb_reader_init(bb_reader *r, sb_slice s) {
+	r->p = (const uint8_t *)s.ptr;
+	r->end = r->p + s.len;
+	r->err = false;
+}
+
+// Checks that `n` more bytes can be read.
+static bool bb_need(bb_reader *r, const size_t n) {
+	if ((size_t)(r->end - r->p) < n) {
+		r->err = true;
+		r->p = r->end;
+		return false;
+	}
+	return true;
+}
+
+uint64_t bb_read_uint(bb_reader *r, unsigned width, int order) {
+	if ((width != 1 && width != 2 && width != 4 && width != 8) || !bb_need(r, width)) {
+		r->err = true;
+		return 0;
+	}
+	uint64_t v = 0;
+	for (unsigned i = 0; i < width; i++) {
+		const unsigned shift = 8 * (order == BB_BE ? width - 1 - i : i);
+		v |= (uint64_t)r->p[i] << shift;
+	}
+	r->p += width;
+	return v;
+}
+
+float bb_read_f32le(bb_reader *r) {
+	const uint32_t u = (uint32_t)bb_read_uint(r, 4, BB_LE);
+	float v;
+	memcpy(&v, &u, 4);
+	return v;
+}
+
+double bb_read_f64le(bb_reader *r) {
+	const uint64_t u = bb_read_uint(r, 8, BB_LE);
+	double v;
+	memcpy(&v, &u, 8);
+	return v;
+}
+
+uint64_t bb_read_varint(bb_reader *r) {
+	uint64_t v = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		if (r->p == r->end) { break; }
+		const uint8_t b = *r->p++;
+		// The tenth byte may only hold the top bit.
+		if (shift == 63 && b > 1) { break; }
+		v |= (uint64_t)(b & 0x7F) << shift;
+		if (!(b & 0x80)) {
+			return v;
+		}
+	}
+	r->err = true;
+	r->p = r->end;
+	return 0;
+}
+
+int64_t bb_read_svarint(bb_reader *r) {
+	return bb_unzigzag(bb_read_varint(r));
+}
+
+sb_slice bb_read_bytes(bb_reader *r, size_t n) {
+	sb_slice s = { (const char *)r->p, 0 };
+	if (!bb_need(r, n)) { return s; }
+	s.len = n;
+	r->p += n;
+	return s;
+}
+
+sb_slice bb_read_blob(bb_reader *r) {
+	const uint64_t n = bb_read_varint(r);
+	if (r->err) {
+		sb_slice s = { (const char *)r->p, 0 };
+		return s;
+	}
+	return bb_read_bytes(r, n > SIZE_MAX ? SIZE_MAX : (size_t)n);
+}
+
+#endif // BB_IMPLEMENTATION
+
+#endif // BB_H
@@ -0,0 +1,451 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sb.h"
+
+// The deepest that objects and arrays may be nested.
+#ifndef JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH 64
+#endif // JSON_MAX_DEPTH
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Streaming JSON writer. It tracks the nesting, so commas and colons are
+ * written for the caller, and it rejects calls that would produce invalid
+ * JSON, such as a value in an object without a key.
+ */
+typedef struct json_writer {
+	string_builder *sb;                 // The string builder to write to.
+	unsigned depth;                     // The number of open objects and arrays.
+	unsigned char kind[JSON_MAX_DEPTH]; // Whether each open container is an object ('{') or an array ('[').
+	bool comma;                         // Whether the next value or key needs a comma.
+	bool key;                           // Whether a key has been written without its value.
+	bool done;                          // Whether the top-level value is complete.
+	bool err;                           // Whether a call failed.
+} json_writer;
+
+/**
+ * Initializes a JSON writer. A string builder with a sink streams the
+ * document out as it is written.
+ * @param w  JSON writer pointer.
+ * @param sb The string builder to write to.
+ */
+void json_init(json_writer *w, string_builder *sb);
+
+/**
+ * Begins an object.
+ * @param w JSON writer pointer.
+ * @return `true` on success; otherwise, `false` if a value is not allowed
+ *         here, the nesting is too deep or a write failed.
+ */
+bool json_begin_object(json_writer *w);
+
+/**
+ * Ends the innermost object.
+ * @param w JSON writer pointer.
+ * @return `true` on success; otherwise, `false` if the innermost container
+ *         is not an object, its last key has no value or a write failed.
+ */
+bool json_end_object(json_writer *w);
+
+/**
+ * Begins an array.
+ * @param w JSON writer pointer.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_begin_array(json_writer *w);
+
+/**
+ * Ends the innermost array.
+ * @param w JSON writer pointer.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_end_array(json_writer *w);
+
+/**
+ * Writes an object key. The next call must write its value.
+ * @param w JSON writer pointer.
+ * @param s The key, which is escaped.
+ * @param n The length of the key.
+ * @return `true` on success; otherwise, `false` if not in an object or a key
+ *         is already waiting for its value.
+ */
+bool json_key(json_writer *w, const char *s, size_t n);
+
+/**
+ * Writes a string. Quotes, backslashes and control characters are escaped;
+ * other bytes, including UTF-8 sequences, are copied as they are.
+ * @param w JSON writer pointer.
+ * @param s The string.
+ * @param n The length of the string.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_string(json_writer *w, const char *s, size_t n);
+
+/**
+ * Writes a signed integer.
+ * @param w JSON writer pointer.
+ * @param v The integer.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_int(json_writer *w, long long v);
+
+/**
+ * Writes an unsigned integer.
+ * @param w JSON writer pointer.
+ * @param v The integer.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_uint(json_writer *w, unsigned long long v);
+
+/**
+ * Writes a double that reads back as the same value. Values with up to 15
+ * significant digits in fixed notation, e.g. `0.1` or `1234.5`, are formatted
+ * directly; others fall back to `%.17g`. NaN and infinities, which JSON cannot
+ * represent, are written as `null`.
+ * @param w JSON writer pointer.
+ * @param v The double.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_double(json_writer *w, double v);
+
+/**
+ * Writes `true` or `false`.
+ * @param w JSON writer pointer.
+ * @param v The boolean.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_bool(json_writer *w, bool v);
+
+/**
+ * Writes `null`.
+ * @param w JSON writer pointer.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_null(json_writer *w);
+
+/**
+ * Writes an already serialized value as it is.
+ * @param w JSON writer pointer.
+ * @param s The serialized value. It must be valid JSON.
+ * @param n The length of the value.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool json_raw(json_writer *w, const char *s, size_t n);
+
+/**
+ * Checks that the document is complete.
+ * @param w JSON writer pointer.
+ * @return `true` if exactly one top-level value was written, every container
+ *         was closed and no call failed; otherwise, `false`.
+ */
+bool json_finish(const json_writer *w);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef JSON_IMPLEMENTATION
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+// The number of string bytes escaped per reservation. Each may take 6 bytes.
+#define JSON_ESCAPE_CHUNK 512
+
+static const char json_digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// Formats `v` right-aligned so that it ends at `end`, two digits at a time.
+static char *json_format_u64(char *end, unsigned long long v) {
+	while (v >= 100) {
+		const unsigned i = (unsigned)(v % 100) * 2;
+		v /= 100;
+		*--end = json_digit_pairs[i+1];
+		*--end = json_digit_pairs[i];
+	}
+	if (v >= 10) {
+		*--end = json_digit_pairs[v*2+1];
+		*--end = json_digit_pairs[v*2];
+	} else {
+		*--end = (char)('0' + v);
+	}
+	return end;
+}
+
+// Writes the separator before a value and checks that a value is allowed.
+static bool json_value_begin(json_writer *w) {
+	if (w->err || w->done) {
+		w->err = true;
+		return false;
+	}
+	if (w->depth > 0 && w->kind[w->depth-1] == '{') {
+		if (!w->key) {
+			w->err = true;
+			return false;
+		}
+	} else if (w->comma) {
+		char *p = sb_reserve(w->sb, 1);
+		if (p == NULL) {
+			w->err = true;
+			return false;
+		}
+		*p = ',';
+		sb_advance(w->sb, 1);
+	}
+	return true;
+}
+
+// Records that a value ended.
+static bool json_value_end(json_writer *w) {
+	w->key = false;
+	w->comma = true;
+	w->done = w->depth == 0;
+	return true;
+}
+
+static bool json_put(json_writer *w, const char *s, const size_t n) {
+	if (sb_writen(w->sb, s, n) != n) {
+		w->err = true;
+		return false;
+	}
+	return true;
+}
+
+// Gets the number of leading bytes that need no escaping.
+static size_t json_clean_run(const char *s, const size_t n) {
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i slash = _mm_set1_epi8('\\');
+	const __m128i ctrl = _mm_set1_epi8(0x1F);
+	for (; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		const __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+			_mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+		const unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+	}
+#endif // __SSE2__
+	for (; i < n; i++) {
+		const unsigned char c = (unsigned char)s[i];
+		if (c == '"' || c == '\\' || c < 0x20) { break; }
+	}
+	return i;
+}
+
+// Writes a quoted, escaped string.
+static bool json_put_string(json_writer *w, const char *s, size_t n) {
+	static const char hex[] = "0123456789abcdef";
+	char *q = sb_reserve(w->sb, 1);
+	if (q == NULL) {
+		w->err = true;
+		return false;
+	}
+	*q = '"';
+	sb_advance(w->sb, 1);
+	while (n > 0) {
+		const size_t chunk = n < JSON_ESCAPE_CHUNK ? n : JSON_ESCAPE_CHUNK;
+		char *dst = sb_reserve(w->sb, chunk * 6);
+		if (dst == NULL) {
+			w->err = true;
+			return false;
+		}
+		char *o = dst;
+		size_t i = 0;
+		while (i < chunk) {
+			const size_t run = json_clean_run(s + i, chunk - i);
+			memcpy(o, s + i, run);
+			o += run;
+			i += run;
+			if (i == chunk) { break; }
+			const unsigned char c = (unsigned char)s[i++];
+			*o++ = '\\';
+			switch (c) {
+			case '"': *o++ = '"'; break;
+			case '\\': *o++ = '\\'; break;
+			case '\b': *o++ = 'b'; break;
+			case '\f': *o++ = 'f'; break;
+			case '\n': *o++ = 'n'; break;
+			case '\r': *o++ = 'r'; break;
+			case '\t': *o++ = 't'; break;
+			default:
+				memcpy(o, "u00", 3);
+				o[3] = hex[c >> 4];
+				o[4] = hex[c & 15];
+				o += 5;
+			}
+		}
+		sb_advance(w->sb, (size_t)(o - dst));
+		s += chunk;
+		n -= chunk;
+	}
+	return json_put(w, "\"", 1);
+}
+
+void json_init(json_writer *w, string_builder *sb) {
+	w->sb = sb;
+	w->depth = 0;
+	w->comma = false;
+	w->key = false;
+	w->done = false;
+	w->err = false;
+}
+
+static bool json_begin(json_writer *w, const char open) {
+	if (!json_value_begin(w)) { return false; }
+	if (w->depth == JSON_MAX_DEPTH) {
+		w->err = true;
+		return false;
+	}
+	if (!json_put(w, &open, 1)) { return false; }
+	w->kind[w->depth++] = (unsigned char)open;
+	w->comma = false;
+	w->key = false;
+	return true;
+}
+
+static bool json_end(json_writer *w, const char open, const char close) {
+	if (w->err || w->depth == 0 || w->kind[w->depth-1] != open || w->key) {
+		w->err = true;
+		return false;
+	}
+	if (!json_put(w, &close, 1)) { return false; }
+	w->depth--;
+	return json_value_end(w);
+}
+
+bool json_begin_object(json_writer *w) {
+	return json_begin(w, '{');
+}
+
+bool json_end_object(json_writer *w) {
+	return json_end(w, '{', '}');
+}
+
+bool json_begin_array(json_writer *w) {
+	return json_begin(w, '[');
+}
+
+bool json_end_array(json_writer *w) {
+	return json_end(w, '[', ']');
+}
+
+bool json_key(json_writer *w, const char *s, size_t n) {
+	if (w->err || w->depth == 0 || w->kind[w->depth-1] != '{' || w->key) {
+		w->err = true;
+		return false;
+	}
+	if (w->comma && !json_put(w, ",", 1)) { return false; }
+	if (!json_put_string(w, s, n) || !json_put(w, ":", 1)) { return false; }
+	w->key = true;
+	return true;
+}
+
+bool json_string(json_writer *w, const char *s, size_t n) {
+	return json_value_begin(w) && json_put_string(w, s, n) && json_value_end(w);
+}
+
+bool json_uint(json_writer *w, unsigned long long v) {
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	char *p = json_format_u64(end, v);
+	return json_value_begin(w) && json_put(w, p, (size_t)(end - p)) && json_value_end(w);
+}
+
+bool json_int(json_writer *w, long long v) {
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	char *p = json_format_u64(end, v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v);
+	if (v < 0) {
+		*--p = '-';
+	}
+	return json_value_begin(w) && json_put(w, p, (size_t)(end - p)) && json_value_end(w);
+}
+
+// Formats `v` as the fewest fixed-point digits that read back exactly, or
+// returns `NULL` if that takes more than 15 significant digits.
+static char *json_format_fixed(char *end, const double v) {
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+	const double a = fabs(v);
+	if (a >= 1e15 || (a != 0 && a < 1e-15)) { return NULL; }
+	for (int k = 0; k < 16; k++) {
+		// Both the division and the parse of the digits are correctly
+		// rounded, so an exact match means the digits round-trip.
+		const double scaled = a * pow10[k];
+		if (scaled >= 1e15) { return NULL; }
+		const unsigned long long m = (unsigned long long)(scaled + 0.5);
+		if ((double)m / pow10[k] != a) { continue; }
+		char *p = end;
+		if (k == 0) {
+			p = json_format_u64(p, m);
+		} else {
+			unsigned long long frac = m;
+			for (int d = 0; d < k; d++) {
+				*--p = (char)('0' + frac % 10);
+				frac /= 10;
+			}
+			*--p = '.';
+			p = json_format_u64(p, frac);
+		}
+		if (signbit(v)) {
+			*--p = '-';
+		}
+		return p;
+	}
+	return NULL;
+}
+
+bool json_double(json_writer *w, double v) {
+	if (isnan(v) || isinf(v)) {
+		return json_null(w);
+	}
+	char buf[40];
+	char *end = buf + sizeof(buf);
+	char *p = json_format_fixed(end, v);
+	if (p == NULL) {
+		const int n = snprintf(buf, sizeof(buf), "%.17g", v);
+		if (n < 0) {
+			w->err = true;
+			return false;
+		}
+		p = buf;
+		end = buf + n;
+	}
+	return json_value_begin(w) && json_put(w, p, (size_t)(end - p)) && json_value_end(w);
+}
+
+bool json_bool(json_writer *w, bool v) {
+	return json_value_begin(w) && (v ? json_put(w, "true", 4) : json_put(w, "false", 5)) && json_value_end(w);
+}
+
+bool json_null(json_writer *w) {
+	return json_value_begin(w) && json_put(w, "null", 4) && json_value_end(w);
+}
+
+bool json_raw(json_writer *w, const char *s, size_t n) {
+	return json_value_begin(w) && json_put(w, s, n) && json_value_end(w);
+}
+
+bool json_finish(const json_writer *w) {
+	return !w->err && w->done && w->depth == 0;
+}
+
+#endif // JSON_IMPLEMENTATION
+
+#endif // JSON_H
@@ -0,0 +1,355 @@
+#ifndef ROPE_H
+#define ROPE_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifndef ROPE_DEFAULT_CHUNK
+#define ROPE_DEFAULT_CHUNK 4096
+#endif // ROPE_DEFAULT_CHUNK
+
+#ifndef ROPE_MAX_CHUNK
+#define ROPE_MAX_CHUNK (1 << 20)
+#endif // ROPE_MAX_CHUNK
+
+/**
+ * A single chunk of a rope. Bytes written to a chunk are never moved.
+ */
+typedef struct rope_chunk {
+	struct rope_chunk *next; // The next chunk in the rope.
+	size_t cap;              // The chunk's capacity.
+	size_t len;              // The chunk's current length.
+	char data[];             // The chunk's bytes.
+} rope_chunk;
+
+/**
+ * Chunked string builder. Appends go into a list of chunks instead of a single
+ * buffer, so growing never copies the bytes that were already written.
+ */
+typedef struct rope {
+	rope_chunk *head; // The first chunk.
+	rope_chunk *tail; // The last chunk, which appends go into.
+	size_t len;       // The rope's total length.
+	size_t chunks;    // The number of chunks.
+	size_t next_cap;  // The capacity of the next chunk.
+	bool grow;        // Whether chunk capacities double up to `ROPE_MAX_CHUNK`.
+} rope;
+
+/**
+ * Initializes a rope with geometrically growing chunks, starting at
+ * `ROPE_DEFAULT_CHUNK` bytes.
+ * @param r Rope pointer.
+ */
+void rope_init(rope *r);
+
+/**
+ * Initializes a rope with a specific chunk capacity.
+ * @param r    Rope pointer.
+ * @param cap  The capacity of the first chunk.
+ * @param grow `true` to double each following chunk up to `ROPE_MAX_CHUNK`;
+ *             `false` to use fixed-size chunks.
+ */
+void rope_init_chunk(rope *r, size_t cap, bool grow);
+
+/**
+ * Deinitializes a rope. Frees every chunk.
+ * @param r Rope pointer.
+ */
+void rope_deinit(rope *r);
+
+/**
+ * Writes a string to the rope.
+ * @param r Rope pointer.
+ * @param s String to write.
+ * @return The number of bytes written.
+ */
+size_t rope_write(rope *r, const char *s);
+
+/**
+ * Writes `n` bytes to the rope. The bytes may be split across chunks.
+ * @param r Rope pointer.
+ * @param s Bytes to write.
+ * @param n The number of bytes to write.
+ * @return The number of bytes written.
+ */
+size_t rope_writen(rope *r, const char *s, size_t n);
+
+/**
+ * Writes a formatted string to the rope. The formatted string is always
+ * contiguous within a single chunk.
+ * @param r      Rope pointer.
+ * @param format The format string.
+ * @param ...    The arguments.
+ * @return The number of bytes written.
+ */
+size_t rope_writef(rope *r, const char *format, ...);
+
+/**
+ * Writes a formatted string to the rope from a `stdarg` list.
+ * @param r      Rope pointer.
+ * @param format The format string.
+ * @param args   `stdarg` list.
+ * @return The number of bytes written.
+ */
+size_t rope_vwritef(rope *r, const char *format, va_list args);
+
+/**
+ * Clears the rope. The first chunk is kept for reuse; the others are freed.
+ * @param r Rope pointer.
+ */
+void rope_clear(rope *r);
+
+/**
+ * Fills an iovec array with the rope's chunks, e.g. for `writev` or `sendmsg`.
+ * @param r   Rope pointer.
+ * @param iov The iovec array.
+ * @param n   The number of entries in `iov`.
+ * @return The number of entries filled. This is less than `r->chunks` if
+ *         `iov` is too small.
+ */
+size_t rope_iovecs(const rope *r, struct iovec *iov, size_t n);
+
+/**
+ * Writes the rope's contents to a file descriptor with `writev`, retrying
+ * partial writes and interrupted calls.
+ * @param r  Rope pointer.
+ * @param fd The file descriptor to write to.
+ * @return The number of bytes written, or `-1` on error with errno set.
+ */
+ssize_t rope_writev(const rope *r, int fd);
+
+/**
+ * Merges the rope into a single chunk and returns its contents. The returned
+ * string is owned by the rope and is valid until the next write.
+ * @param r Rope pointer.
+ * @return The rope's contents as a null-terminated string, or `NULL` if the
+ *         allocation failed.
+ */
+const char *rope_flatten(rope *r);
+
+/**
+ * Gets an allocated, null-terminated copy of the rope's contents.
+ * The caller owns the returned string and is responsible for freeing it.
+ * @param r Rope pointer.
+ * @return An allocated copy of the rope's contents.
+ */
+char *rope_to_string(const rope *r);
+
+#ifdef ROPE_IMPLEMENTATION
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef ROPE_IOV_BATCH
+#define ROPE_IOV_BATCH 64
+#endif // ROPE_IOV_BATCH
+
+void rope_init(rope *r) {
+	rope_init_chunk(r, ROPE_DEFAULT_CHUNK, true);
+}
+
+void rope_init_chunk(rope *r, size_t cap, bool grow) {
+	r->head = NULL;
+	r->tail = NULL;
+	r->len = 0;
+	r->chunks = 0;
+	r->next_cap = cap > 0 ? cap : 1;
+	r->grow = grow;
+}
+
+void rope_deinit(rope *r) {
+	if (r == NULL) { return; }
+	rope_chunk *c = r->head;
+	while (c != NULL) {
+		rope_chunk *next = c->next;
+		free(c);
+		c = next;
+	}
+	r->head = NULL;
+	r->tail = NULL;
+	r->len = 0;
+	r->chunks = 0;
+}
+
+static rope_chunk *rope_push_chunk(rope *r, size_t min_cap) {
+	size_t cap = r->next_cap > min_cap ? r->next_cap : min_cap;
+	rope_chunk *c = (rope_chunk *)malloc(sizeof(rope_chunk) + cap);
+	if (c == NULL) { return NULL; }
+	c->next = NULL;
+	c->cap = cap;
+	c->len = 0;
+	if (r->tail != NULL) {
+		r->tail->next = c;
+	} else {
+		r->head = c;
+	}
+	r->tail = c;
+	r->chunks++;
+	if (r->grow && r->next_cap < ROPE_MAX_CHUNK) {
+		r->next_cap *= 2;
+	}
+	return c;
+}
+
+size_t rope_write(rope *r, const char *s) {
+	if (r == NULL || s == NULL) { return 0; }
+	return rope_writen(r, s, strlen(s));
+}
+
+size_t rope_writen(rope *r, const char *s, size_t n) {
+	if (r == NULL || s == NULL) { return 0; }
+	size_t written = 0;
+	while (written < n) {
+		rope_chunk *c = r->tail;
+		if (c == NULL || c->len == c->cap) {
+			c = rope_push_chunk(r, 1);
+			if (c == NULL) { break; }
+		}
+		size_t room = c->cap - c->len;
+		size_t m = n - written < room ? n - written : room;
+		memcpy(c->data + c->len, s + written, m);
+		c->len += m;
+		written += m;
+	}
+	r->len += written;
+	return written;
+}
+
+size_t rope_writef(rope *r, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	const size_t n = rope_vwritef(r, format, args);
+	va_end(args);
+	return n;
+}
+
+size_t rope_vwritef(rope *r, const char *format, va_list args) {
+	va_list args_copy;
+	va_copy(args_copy, args);
+	const int len = vsnprintf(NULL, 0, format, args_copy);
+	va_end(args_copy);
+	if (len < 0) {
+		return 0;
+	}
+	// vsnprintf needs room for the terminator, which is not counted in `len`.
+	rope_chunk *c = r->tail;
+	if (c == NULL || c->cap - c->len < (size_t)len+1) {
+		c = rope_push_chunk(r, (size_t)len+1);
+		if (c == NULL) { return 0; }
+	}
+	const int written = vsnprintf(c->data + c->len, len+1, format, args);
+	if (written < 0) {
+		return 0;
+	}
+	c->len += written;
+	r->len += written;
+	return written;
+}
+
+void rope_clear(rope *r) {
+	if (r == NULL || r->head == NULL) { return; }
+	rope_chunk *c = r->head->next;
+	while (c != NULL) {
+		rope_chunk *next = c->next;
+		free(c);
+		c = next;
+	}
+	r->head->next = NULL;
+	r->head->len = 0;
+	r->tail = r->head;
+	r->len = 0;
+	r->chunks = 1;
+}
+
+size_t rope_iovecs(const rope *r, struct iovec *iov, size_t n) {
+	size_t i = 0;
+	for (const rope_chunk *c = r->head; c != NULL && i < n; c = c->next) {
+		if (c->len == 0) { continue; }
+		iov[i].iov_base = (void *)c->data;
+		iov[i].iov_len = c->len;
+		i++;
+	}
+	return i;
+}
+
+ssize_t rope_writev(const rope *r, int fd) {
+	struct iovec iov[ROPE_IOV_BATCH];
+	const rope_chunk *c = r->head;
+	size_t off = 0; // Offset into `c` that has not been written yet.
+	size_t total = 0;
+	while (c != NULL) {
+		int n = 0;
+		const rope_chunk *it = c;
+		size_t it_off = off;
+		for (; it != NULL && n < ROPE_IOV_BATCH; it = it->next, it_off = 0) {
+			if (it->len == it_off) { continue; }
+			iov[n].iov_base = (void *)(it->data + it_off);
+			iov[n].iov_len = it->len - it_off;
+			n++;
+		}
+		if (n == 0) { break; }
+		ssize_t w = writev(fd, iov, n);
+		if (w < 0) {
+			if (errno == EINTR) { continue; }
+			return -1;
+		}
+		total += (size_t)w;
+		// Advance past the bytes that were written.
+		size_t left = (size_t)w;
+		while (c != NULL && left >= c->len - off) {
+			left -= c->len - off;
+			c = c->next;
+			off = 0;
+		}
+		off += left;
+	}
+	return (ssize_t)total;
+}
+
+const char *rope_flatten(rope *r) {
+	if (r == NULL) { return NULL; }
+	if (r->head != NULL && r->head == r->tail && r->head->len < r->head->cap) {
+		r->head->data[r->head->len] = '\0';
+		return r->head->data;
+	}
+	rope_chunk *c = (rope_chunk *)malloc(sizeof(rope_chunk) + r->len + 1);
+	if (c == NULL) { return NULL; }
+	c->next = NULL;
+	c->cap = r->len + 1;
+	c->len = 0;
+	for (rope_chunk *it = r->head; it != NULL; it = it->next) {
+		memcpy(c->data + c->len, it->data, it->len);
+		c->len += it->len;
+	}
+	c->data[c->len] = '\0';
+	size_t next_cap = r->next_cap;
+	rope_deinit(r);
+	r->head = c;
+	r->tail = c;
+	r->len = c->len;
+	r->chunks = 1;
+	r->next_cap = next_cap;
+	return c->data;
+}
+
+char *rope_to_string(const rope *r) {
+	if (r == NULL) { return NULL; }
+	char *s = (char *)malloc(r->len + 1);
+	if (s == NULL) { return NULL; }
+	size_t off = 0;
+	for (const rope_chunk *c = r->head; c != NULL; c = c->next) {
+		memcpy(s + off, c->data, c->len);
+		off += c->len;
+	}
+	s[off] = '\0';
+	return s;
+}
+
+#endif // ROPE_IMPLEMENTATION
+
+#endif // ROPE_H
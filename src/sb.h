@@ -3,12 +3,122 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
 
 #ifndef SB_DEFAULT_CAP
 #define SB_DEFAULT_CAP 32
 #endif // SB_DEFAULT_CAP
 
+#ifndef SB_SSO_CAP
+#define SB_SSO_CAP 64
+#endif // SB_SSO_CAP
+
+// The number of appended bytes a hashing builder lets accumulate before it
+// hashes them, so small appends are hashed in bulk while still in cache.
+#ifndef SB_HASH_LAG
+#define SB_HASH_LAG 256
+#endif // SB_HASH_LAG
+
+/**
+ * String builder flags.
+ */
+enum {
+	SB_INLINE = 1 << 0,    // The buffer is the builder's inline storage.
+	SB_MMAP = 1 << 1,      // The buffer is an anonymous memory mapping.
+	SB_HUGEPAGE = 1 << 2,  // The mapping is advised to use transparent huge pages.
+	SB_NOZERO = 1 << 3,    // Only the null terminator at `len` is maintained.
+};
+
+typedef struct sb_sink sb_sink;
+
+/**
+ * Sink write callback. Must write all of the provided bytes.
+ * @param sink Sink pointer.
+ * @param buf  Bytes to write.
+ * @param len  The number of bytes to write.
+ * @return `true` if every byte was written; otherwise, `false`.
+ */
+typedef bool (*sb_sink_fn)(sb_sink *sink, const char *buf, size_t len);
+
+/**
+ * Destination that a bounded string builder flushes to when it is full.
+ */
+struct sb_sink {
+	sb_sink_fn write; // The sink's write callback.
+	void *ctx;        // User context, or the `FILE *` of a file sink.
+	int fd;           // The file descriptor of an fd sink; otherwise `-1`.
+	int err;          // The errno of the last failed write, or zero (0).
+};
+
+/**
+ * Custom allocator for a string builder's buffer.
+ */
+typedef struct sb_allocator {
+	// Resizes `ptr` from `old_size` to `new_size` bytes, or allocates when
+	// `ptr` is `NULL`. Returns `NULL` on failure.
+	void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+	// Frees `ptr`, which is `size` bytes. May be `NULL` if freeing is a no-op.
+	void (*free)(void *ctx, void *ptr, size_t size);
+} sb_allocator;
+
+/**
+ * A buffer detached from a string builder with `sb_detach`. The caller owns it
+ * and releases it with `sb_span_free`.
+ */
+typedef struct sb_span {
+	char *ptr;                 // The null-terminated contents.
+	size_t len;                // The length of the contents.
+	size_t cap;                // The size of the allocation.
+	unsigned flags;            // `SB_MMAP` if the allocation is a mapping.
+	const sb_allocator *alloc; // The allocator that owns it, or `NULL`.
+	void *alloc_ctx;           // The allocator's context.
+} sb_span;
+
+/**
+ * Non-owning view of bytes, e.g. a string builder's contents.
+ */
+typedef struct sb_slice {
+	const char *ptr; // The first byte.
+	size_t len;      // The number of bytes.
+} sb_slice;
+
+/**
+ * Streaming XXH64 state. A string builder with hashing enabled updates it as
+ * bytes are appended; see `sb_hash_enable`.
+ */
+typedef struct sb_hash {
+	uint64_t v[4];         // The accumulators of the four lanes.
+	uint64_t total;        // The number of bytes hashed.
+	uint64_t seed;         // The seed.
+	unsigned char mem[32]; // The bytes of an incomplete 32-byte stripe.
+	unsigned mem_len;      // The number of bytes in `mem`.
+	size_t pos;            // How far into the builder's buffer bytes are hashed.
+} sb_hash;
+
+#ifdef SB_STATS
+/**
+ * String builder counters, kept when `SB_STATS` is defined. It must be
+ * defined the same way in every translation unit, since it adds a field to
+ * `string_builder`.
+ */
+typedef struct sb_stats {
+	uint64_t grows;       // Successful `sb_grow` calls.
+	uint64_t grow_copied; // Bytes copied by growing, i.e. realloc moves and inline spills.
+	uint64_t zeroed;      // Bytes zeroed by initializing, growing and clearing.
+	uint64_t vsnprintf;   // `vsnprintf` calls.
+	uint64_t finished;    // Builders deinitialized or detached.
+	uint64_t final_len;   // Their total length when they were finished.
+	uint64_t final_cap;   // Their total capacity when they were finished.
+} sb_stats;
+#endif // SB_STATS
+
 /**
  * String builder structure.
  */
@@ -16,8 +126,44 @@ typedef struct string_builder {
     char *buf;  // The string builder's buffer.
 	size_t cap; // The string builder's capacity.
 	size_t len; // The string builder' current length.
+	unsigned flags;       // The string builder's flags (`SB_*`).
+	unsigned flushes;     // The number of flushes to the sink, which move the contents.
+	sb_sink *sink;        // The sink to flush to when full, or `NULL`.
+	const sb_allocator *alloc; // The custom allocator, or `NULL`.
+	void *alloc_ctx;           // The custom allocator's context.
+	sb_hash *hash;             // The hash to update on appends, or `NULL`.
+#ifdef SB_STATS
+	sb_stats stats;            // Counters since initialization.
+#endif // SB_STATS
 } string_builder;
 
+/**
+ * String builder with inline storage for short contents; see `sb_init_sso`.
+ */
+typedef struct sb_small {
+	string_builder sb;    // The string builder.
+	char sso[SB_SSO_CAP]; // Inline storage, used until the contents outgrow it.
+} sb_small;
+
+/**
+ * A point to roll a string builder back to; see `sb_snapshot`.
+ */
+typedef struct sb_mark {
+	size_t len;   // The length of the contents.
+	sb_hash hash; // The hash state, if hashing is enabled.
+} sb_mark;
+
+/**
+ * Gets a view of the string builder's contents. The view is invalidated by the
+ * next write.
+ * @param sb String builder pointer.
+ * @return The string builder's contents.
+ */
+static inline sb_slice sb_as_slice(const string_builder *sb) {
+	sb_slice s = { sb->buf, sb->len };
+	return s;
+}
+
 /**
  * Initializes a string builder.
  * @param sb String builder pointer.
@@ -31,6 +177,127 @@ void sb_init(string_builder *sb);
  */
 void sb_init_cap(string_builder *sb, size_t cap);
 
+/**
+ * Initializes a string builder with a specific cap and flags.
+ *
+ * With `SB_MMAP`, the buffer is an anonymous memory mapping rounded up to
+ * whole pages. It grows with `mremap` on Linux, which moves pages instead of
+ * copying them, and is not zeroed because new pages are already zero. This
+ * suits builders that grow to hundreds of megabytes. `SB_HUGEPAGE` further
+ * advises the kernel to back the mapping with transparent huge pages.
+ *
+ * With `SB_NOZERO`, the buffer is never zeroed past the null terminator at
+ * `len`: initializing and growing skip the `memset`, and `sb_clear` is O(1)
+ * instead of O(capacity). Bytes past the terminator are unspecified.
+ * @param sb    String builder pointer.
+ * @param cap   The initial capacity for the string builder.
+ * @param flags The string builder's flags (`SB_MMAP`, `SB_HUGEPAGE`,
+ *              `SB_NOZERO`).
+ */
+void sb_init_flags(string_builder *sb, size_t cap, unsigned flags);
+
+/**
+ * Initializes a string builder that stores its contents inline until they
+ * outgrow `SB_SSO_CAP` bytes, at which point they spill to the heap. Short
+ * builders never allocate. The buffer points into `small` itself, so it must
+ * not be copied while it is inline.
+ * @param small Small string builder pointer.
+ * @return The string builder, i.e. `&small->sb`.
+ */
+string_builder *sb_init_sso(sb_small *small);
+
+/**
+ * Initializes a string builder whose buffer comes from a custom allocator.
+ * @param sb    String builder pointer.
+ * @param cap   The initial capacity for the string builder.
+ * @param alloc The allocator. It must outlive the string builder.
+ * @param ctx   The allocator's context, passed to each call.
+ */
+void sb_init_alloc(string_builder *sb, size_t cap, const sb_allocator *alloc, void *ctx);
+
+#ifdef ARENA_H
+/**
+ * Initializes a string builder whose buffer is allocated from an arena. The
+ * buffer grows in place while it is the arena's most recent allocation.
+ * Requires `arena.h` to be included before `sb.h`.
+ * @param sb  String builder pointer.
+ * @param cap The initial capacity for the string builder.
+ * @param a   Arena pointer.
+ */
+void sb_init_arena(string_builder *sb, size_t cap, arena *a);
+#endif // ARENA_H
+
+/**
+ * Initializes a bounded string builder that flushes its contents to a sink
+ * whenever the next write does not fit, so memory use stays at `cap` bytes
+ * regardless of the output size. Only a single formatted write larger than
+ * `cap` grows the buffer. Call `sb_flush` before `sb_deinit` to write out the
+ * remaining contents.
+ * @param sb   String builder pointer.
+ * @param cap  The capacity of the buffer.
+ * @param sink The sink to flush to. It must outlive the string builder.
+ */
+void sb_init_sink(string_builder *sb, size_t cap, sb_sink *sink);
+
+/**
+ * Creates a sink that writes to a file descriptor.
+ * @param fd The file descriptor.
+ * @return The sink.
+ */
+sb_sink sb_sink_fd(int fd);
+
+/**
+ * Creates a sink that writes to a `FILE *` stream.
+ * @param fp The stream.
+ * @return The sink.
+ */
+sb_sink sb_sink_file(FILE *fp);
+
+/**
+ * Creates a sink that calls a user-provided write callback.
+ * @param fn  The write callback.
+ * @param ctx User context, available as `sink->ctx` in the callback.
+ * @return The sink.
+ */
+sb_sink sb_sink_callback(sb_sink_fn fn, void *ctx);
+
+/**
+ * Writes the string builder's contents to its sink and clears it. Does
+ * nothing if the string builder has no sink.
+ * @param sb String builder pointer.
+ * @return `true` if the contents were written; otherwise, `false` and
+ *         `sb->sink->err` holds the error.
+ */
+bool sb_flush(string_builder *sb);
+
+#ifdef __linux__
+/**
+ * Flushes the string builder, then copies `count` bytes from `in_fd` to the
+ * sink's file descriptor in the kernel with `sendfile`, e.g. to send a file
+ * to a socket. Falls back to `read`/`write` if `sendfile` is unsupported for
+ * the descriptors.
+ * @param sb     String builder pointer. Its sink must be an fd sink.
+ * @param in_fd  The file descriptor to read from.
+ * @param offset The offset to read from, which is updated; or `NULL` to use
+ *               and update the file offset of `in_fd`.
+ * @param count  The number of bytes to copy.
+ * @return The number of bytes copied, or `-1` on error with errno set.
+ */
+ssize_t sb_sendfile(string_builder *sb, int in_fd, off_t *offset, size_t count);
+
+/**
+ * Flushes the string builder, then moves `count` bytes from `in_fd` to the
+ * sink's file descriptor in the kernel with `splice`. One of the two file
+ * descriptors must be a pipe. Without _GNU_SOURCE this copies through
+ * user space instead.
+ * @param sb    String builder pointer. Its sink must be an fd sink.
+ * @param in_fd The file descriptor to read from.
+ * @param count The number of bytes to move.
+ * @return The number of bytes moved, or `-1` on error with errno set.
+ */
+ssize_t sb_splice(string_builder *sb, int in_fd, size_t count);
+#endif // __linux__
+
 /**
  * Deinitializes a string builder. Frees the internal buffer and sets the
  * capacity and length to zero (0). The string builder must be reinitialized
@@ -47,6 +314,15 @@ void sb_deinit(string_builder *sb);
  */
 size_t sb_write(string_builder *sb, const char *s);
 
+/**
+ * Writes `n` bytes to the string builder's internal buffer.
+ * @param sb String builder pointer.
+ * @param s  Bytes to write.
+ * @param n  The number of bytes to write.
+ * @return The number of bytes written.
+ */
+size_t sb_writen(string_builder *sb, const char *s, size_t n);
+
 /**
  * Writes a formatted string to the string builder's internal buffer.
  * @param sb String builder pointer.
@@ -81,6 +357,143 @@ void sb_clear(string_builder *sb);
  */
 bool sb_grow(string_builder *sb, size_t size);
 
+/**
+ * Makes room for `n` more bytes (plus the null terminator), flushing or
+ * growing the buffer as needed. The bytes can then be written directly to the
+ * returned pointer and committed with `sb_advance`.
+ * @param sb String builder pointer.
+ * @param n  The number of bytes to reserve.
+ * @return A pointer to the end of the contents, or `NULL` on failure.
+ */
+char *sb_reserve(string_builder *sb, size_t n);
+
+/**
+ * Commits `n` bytes written to the space returned by `sb_reserve`.
+ * @param sb String builder pointer.
+ * @param n  The number of bytes written. Must not exceed the reservation.
+ */
+void sb_advance(string_builder *sb, size_t n);
+
+/**
+ * Finds the first occurrence of `needle` in the string builder's contents at
+ * or after `from`.
+ * @param sb     String builder pointer.
+ * @param from   The offset to start searching at.
+ * @param needle Bytes to search for.
+ * @param n      The number of bytes in `needle`.
+ * @return The offset of the occurrence, or `-1` if there is none.
+ */
+ssize_t sb_find(const string_builder *sb, size_t from, const char *needle, size_t n);
+
+/**
+ * Inserts `n` bytes at `pos`, shifting the rest of the contents back.
+ * @param sb  String builder pointer.
+ * @param pos The offset to insert at. Must not exceed the length.
+ * @param s   Bytes to insert. May point into the string builder's contents.
+ * @param n   The number of bytes to insert.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool sb_insert(string_builder *sb, size_t pos, const char *s, size_t n);
+
+/**
+ * Erases up to `n` bytes at `pos`, shifting the rest of the contents forward.
+ * @param sb  String builder pointer.
+ * @param pos The offset to erase at.
+ * @param n   The number of bytes to erase.
+ * @return The number of bytes erased.
+ */
+size_t sb_erase(string_builder *sb, size_t pos, size_t n);
+
+/**
+ * Replaces every non-overlapping occurrence of `from` with `to`, scanning left
+ * to right. The new length is computed first, so the buffer is grown at most
+ * once and each byte is moved at most twice.
+ * @param sb     String builder pointer.
+ * @param from   Bytes to replace. Must not point into the string builder's
+ *               contents.
+ * @param from_n The number of bytes in `from`. Nothing is replaced if zero (0).
+ * @param to     Replacement bytes. Must not point into the string builder's
+ *               contents.
+ * @param to_n   The number of bytes in `to`.
+ * @return The number of replacements, or zero (0) if the buffer could not grow.
+ */
+size_t sb_replace_all(string_builder *sb, const char *from, size_t from_n, const char *to, size_t to_n);
+
+/**
+ * Resets a hash state.
+ * @param h    Hash state pointer.
+ * @param seed The seed.
+ */
+void sb_hash_reset(sb_hash *h, uint64_t seed);
+
+/**
+ * Hashes `n` more bytes.
+ * @param h Hash state pointer.
+ * @param s Bytes to hash.
+ * @param n The number of bytes to hash.
+ */
+void sb_hash_update(sb_hash *h, const char *s, size_t n);
+
+/**
+ * Gets the XXH64 digest of the bytes hashed so far, which is the same as a
+ * one-shot XXH64 of them. The state is not modified, so hashing can continue.
+ * @param h Hash state pointer.
+ * @return The digest.
+ */
+uint64_t sb_hash_digest(const sb_hash *h);
+
+/**
+ * Enables incremental hashing of the string builder's contents. Appended
+ * bytes are hashed once `SB_HASH_LAG` of them have accumulated, while they are
+ * still in cache, so the digest of the finished contents is available from
+ * `sb_digest` without reading them again. The current contents are hashed
+ * first.
+ *
+ * Flushing to a sink keeps the hash, so it covers all of the output except
+ * bytes copied by `sb_sendfile` and `sb_splice`. `sb_clear` and `sb_detach`
+ * reset it. In-place edits (`sb_insert`, `sb_erase`, `sb_replace_all`, and the
+ * transforms in `sb_xform.h`) rehash the contents with `sb_hash_sync`.
+ * @param sb   String builder pointer.
+ * @param h    The hash state. It must outlive the string builder, or `NULL`
+ *             to disable hashing.
+ * @param seed The seed.
+ */
+void sb_hash_enable(string_builder *sb, sb_hash *h, uint64_t seed);
+
+/**
+ * Gets the digest of the string builder's contents, hashing the last few
+ * appended bytes first.
+ * @param sb String builder pointer. Hashing must be enabled.
+ * @return The digest.
+ */
+uint64_t sb_digest(string_builder *sb);
+
+/**
+ * Rehashes the string builder's contents after they were modified in place.
+ * For a builder with a sink, the hash then covers only the unflushed contents.
+ * Does nothing if hashing is not enabled.
+ * @param sb String builder pointer.
+ */
+void sb_hash_sync(string_builder *sb);
+
+/**
+ * Takes a snapshot of the string builder's length and hash state.
+ * @param sb String builder pointer.
+ * @return The snapshot.
+ */
+sb_mark sb_snapshot(string_builder *sb);
+
+/**
+ * Discards everything appended since a snapshot, restoring the hash state in
+ * O(1). The contents before the snapshot must not have been flushed or edited
+ * in place since.
+ * @param sb String builder pointer.
+ * @param m  The snapshot.
+ * @return `true` on success; otherwise, `false` if the contents are shorter
+ *         than at the snapshot.
+ */
+bool sb_rollback(string_builder *sb, const sb_mark *m);
+
 /**
  * Gets an allocated copy of the string builder's internal buffer.
  * The caller owns the returned string and is responsible for freeing it.
@@ -89,38 +502,452 @@ bool sb_grow(string_builder *sb, size_t size);
  */
 char *sb_to_string(const string_builder *sb);
 
+/**
+ * Transfers ownership of the string builder's buffer to the caller without
+ * copying it, and leaves the string builder empty but usable. Only an inline
+ * (`sb_init_sso`) buffer has to be copied to the heap.
+ * @param sb     String builder pointer.
+ * @param shrink `true` to shrink the allocation to fit the contents.
+ * @return The detached buffer, which is `{0}` if the builder has none. Release
+ *         it with `sb_span_free`, or with `free` if `flags` and `alloc` are
+ *         both unset.
+ */
+sb_span sb_detach(string_builder *sb, bool shrink);
+
+/**
+ * Frees a buffer detached with `sb_detach`, using the backend it came from.
+ * @param span Span pointer.
+ */
+void sb_span_free(sb_span *span);
+
+#ifdef SB_STATS
+/**
+ * Gets a string builder's counters since it was initialized. `finished` is
+ * zero (0), and `final_len` and `final_cap` are its current length and
+ * capacity.
+ * @param sb String builder pointer.
+ * @return The counters.
+ */
+sb_stats sb_stats_get(const string_builder *sb);
+
+/**
+ * Gets the sum of the counters of every finished string builder. Builders
+ * are added when they are deinitialized or detached.
+ * @return The counters.
+ */
+sb_stats sb_stats_global(void);
+
+/**
+ * Resets the global counters to zero (0).
+ */
+void sb_stats_reset_global(void);
+
+/**
+ * Adds a string builder's counters to the global ones and resets them.
+ * `sb_deinit` and `sb_detach` call this; other code that takes over a
+ * builder's buffer should too.
+ * @param sb String builder pointer.
+ */
+void sb_stats_retire(string_builder *sb);
+#endif // SB_STATS
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
 #ifdef SB_IMPLEMENTATION
 
-#include <stdio.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#endif // __linux__
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif // !MAP_ANONYMOUS && MAP_ANON
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#if defined(_GNU_SOURCE) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define SB_HAVE_MEMMEM
+#endif // _GNU_SOURCE || BSD
+
+#if defined(_GNU_SOURCE) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L) || (defined(_XOPEN_SOURCE) && _XOPEN_SOURCE >= 500)
+#define SB_HAVE_PREAD
+#endif // _GNU_SOURCE || _POSIX_C_SOURCE || _XOPEN_SOURCE
+
+#ifdef SB_STATS
+#define SB_STAT(sb, field, n) ((sb)->stats.field += (uint64_t)(n))
+#define SB_STATS_RESET(sb) memset(&(sb)->stats, 0, sizeof((sb)->stats))
+#else
+#define SB_STAT(sb, field, n) ((void)0)
+#define SB_STATS_RESET(sb) ((void)0)
+#endif // SB_STATS
+
+static size_t sb_page_round(const size_t size) {
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	return (size + page - 1) & ~(page - 1);
+}
+
+static char *sb_mmap(const size_t cap, const unsigned flags) {
+#ifndef MAP_ANONYMOUS
+	(void)cap;
+	(void)flags;
+	return NULL;
+#else
+	void *p = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) { return NULL; }
+#ifdef MADV_HUGEPAGE
+	if (flags & SB_HUGEPAGE) {
+		madvise(p, cap, MADV_HUGEPAGE);
+	}
+#else
+	(void)flags;
+#endif // MADV_HUGEPAGE
+	return (char *)p;
+#endif // MAP_ANONYMOUS
+}
+
+static char *sb_mremap(string_builder *sb, const size_t new_cap) {
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+	void *p = mremap(sb->buf, sb->cap, new_cap, MREMAP_MAYMOVE);
+	if (p == MAP_FAILED) { return NULL; }
+#ifdef MADV_HUGEPAGE
+	if (sb->flags & SB_HUGEPAGE) {
+		madvise(p, new_cap, MADV_HUGEPAGE);
+	}
+#endif // MADV_HUGEPAGE
+	return (char *)p;
+#else
+	// `mremap` is Linux-specific and only declared with _GNU_SOURCE.
+	char *p = sb_mmap(new_cap, sb->flags);
+	if (p == NULL) { return NULL; }
+	memcpy(p, sb->buf, sb->len + 1);
+	SB_STAT(sb, grow_copied, sb->len + 1);
+	munmap(sb->buf, sb->cap);
+	return p;
+#endif // __linux__ && MREMAP_MAYMOVE
+}
+
+// Hashes the bytes appended since the hash last caught up.
+static void sb_hash_catch_up(string_builder *sb) {
+	if (sb->buf != NULL && sb->len > sb->hash->pos) {
+		sb_hash_update(sb->hash, sb->buf + sb->hash->pos, sb->len - sb->hash->pos);
+	}
+	sb->hash->pos = sb->len;
+}
 
 void sb_init(string_builder *sb) {
 	sb_init_cap(sb, SB_DEFAULT_CAP);
 }
 
 void sb_init_cap(string_builder *sb, size_t cap) {
+	sb_init_flags(sb, cap, 0);
+}
+
+void sb_init_flags(string_builder *sb, size_t cap, unsigned flags) {
 	cap = cap > 0 ? cap : 1;
-	sb->buf = malloc(cap);
+	flags &= SB_MMAP | SB_HUGEPAGE | SB_NOZERO;
+#ifndef MAP_ANONYMOUS
+	// Without anonymous mappings the buffer comes from `malloc`.
+	flags &= ~(SB_MMAP | SB_HUGEPAGE);
+#endif // MAP_ANONYMOUS
+	sb->len = 0;
+	sb->flags = flags;
+	sb->flushes = 0;
+	sb->sink = NULL;
+	sb->alloc = NULL;
+	sb->alloc_ctx = NULL;
+	sb->hash = NULL;
+	SB_STATS_RESET(sb);
+	if (flags & SB_MMAP) {
+		cap = sb_page_round(cap);
+		sb->buf = sb_mmap(cap, flags);
+	} else {
+		sb->buf = (char *)malloc(cap);
+	}
+	if (sb->buf == NULL) {
+		sb->cap = 0;
+		sb->flags = 0;
+		return;
+	}
+	if (flags & SB_NOZERO) {
+		sb->buf[0] = 0;
+	} else if (!(flags & SB_MMAP)) {
+		memset(sb->buf, 0, cap);
+		SB_STAT(sb, zeroed, cap);
+	}
+	sb->cap = cap;
+}
+
+string_builder *sb_init_sso(sb_small *small) {
+	string_builder *sb = &small->sb;
+	memset(small->sso, 0, SB_SSO_CAP);
+	sb->buf = small->sso;
+	sb->cap = SB_SSO_CAP;
+	sb->len = 0;
+	sb->flags = SB_INLINE;
+	sb->flushes = 0;
+	sb->sink = NULL;
+	sb->alloc = NULL;
+	sb->alloc_ctx = NULL;
+	sb->hash = NULL;
+	SB_STATS_RESET(sb);
+	SB_STAT(sb, zeroed, SB_SSO_CAP);
+	return sb;
+}
+
+void sb_init_alloc(string_builder *sb, size_t cap, const sb_allocator *alloc, void *ctx) {
+	cap = cap > 0 ? cap : 1;
+	sb->len = 0;
+	sb->flags = 0;
+	sb->flushes = 0;
+	sb->sink = NULL;
+	sb->alloc = alloc;
+	sb->alloc_ctx = ctx;
+	sb->hash = NULL;
+	SB_STATS_RESET(sb);
+	sb->buf = (char *)alloc->realloc(ctx, NULL, 0, cap);
 	if (sb->buf == NULL) {
 		sb->cap = 0;
-		sb->len = 0;
 		return;
 	}
 	memset(sb->buf, 0, cap);
+	SB_STAT(sb, zeroed, cap);
 	sb->cap = cap;
+}
+
+#ifdef ARENA_H
+static void *sb_arena_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+	return arena_realloc((arena *)ctx, ptr, old_size, new_size);
+}
+
+static const sb_allocator sb_arena_allocator = {
+	.realloc = sb_arena_realloc,
+	.free = NULL,
+};
+
+void sb_init_arena(string_builder *sb, size_t cap, arena *a) {
+	sb_init_alloc(sb, cap, &sb_arena_allocator, a);
+}
+#endif // ARENA_H
+
+void sb_init_sink(string_builder *sb, size_t cap, sb_sink *sink) {
+	sb_init_cap(sb, cap);
+	sb->sink = sink;
+}
+
+static bool sb_sink_fd_write(sb_sink *sink, const char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(sink->fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) { continue; }
+			sink->err = errno;
+			return false;
+		}
+		buf += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+static bool sb_sink_file_write(sb_sink *sink, const char *buf, size_t len) {
+	// A short write need not set errno, so a stale value must not be reported.
+	errno = 0;
+	if (fwrite(buf, 1, len, (FILE *)sink->ctx) != len) {
+		sink->err = errno != 0 ? errno : EIO;
+		return false;
+	}
+	return true;
+}
+
+sb_sink sb_sink_fd(int fd) {
+	return (sb_sink){ .write = sb_sink_fd_write, .ctx = NULL, .fd = fd, .err = 0 };
+}
+
+sb_sink sb_sink_file(FILE *fp) {
+	return (sb_sink){ .write = sb_sink_file_write, .ctx = fp, .fd = -1, .err = 0 };
+}
+
+sb_sink sb_sink_callback(sb_sink_fn fn, void *ctx) {
+	return (sb_sink){ .write = fn, .ctx = ctx, .fd = -1, .err = 0 };
+}
+
+bool sb_flush(string_builder *sb) {
+	if (sb == NULL || sb->sink == NULL) { return true; }
+	if (sb->hash != NULL) {
+		sb_hash_catch_up(sb);
+	}
+	if (sb->len > 0 && !sb->sink->write(sb->sink, sb->buf, sb->len)) {
+		return false;
+	}
+	// Keep the buffer zero past the (now empty) contents.
+	if (!(sb->flags & SB_NOZERO) && sb->buf != NULL) {
+		memset(sb->buf, 0, sb->len);
+		SB_STAT(sb, zeroed, sb->len);
+	}
 	sb->len = 0;
+	sb->flushes++;
+	if (sb->hash != NULL) {
+		sb->hash->pos = 0;
+	}
+	if (sb->buf != NULL) {
+		sb->buf[0] = 0;
+	}
+	return true;
 }
 
+#ifdef __linux__
+static ssize_t sb_copy_fd(int out_fd, int in_fd, off_t *offset, size_t count) {
+	char buf[8192];
+	size_t total = 0;
+	ssize_t result = 0;
+#ifndef SB_HAVE_PREAD
+	// Without `pread`, read at the offset and put the file position back.
+	off_t saved = -1;
+	if (offset != NULL) {
+		saved = lseek(in_fd, 0, SEEK_CUR);
+		if (saved < 0 || lseek(in_fd, *offset, SEEK_SET) < 0) { return -1; }
+	}
+#endif // SB_HAVE_PREAD
+	while (total < count) {
+		size_t want = count - total < sizeof(buf) ? count - total : sizeof(buf);
+#ifdef SB_HAVE_PREAD
+		ssize_t n = offset != NULL ? pread(in_fd, buf, want, *offset) : read(in_fd, buf, want);
+#else
+		ssize_t n = read(in_fd, buf, want);
+#endif // SB_HAVE_PREAD
+		if (n < 0) {
+			if (errno == EINTR) { continue; }
+			result = -1;
+			break;
+		}
+		if (n == 0) { break; }
+		for (ssize_t off = 0; off < n;) {
+			ssize_t w = write(out_fd, buf + off, n - off);
+			if (w < 0) {
+				if (errno == EINTR) { continue; }
+				result = -1;
+				break;
+			}
+			off += w;
+		}
+		if (result < 0) { break; }
+		if (offset != NULL) { *offset += n; }
+		total += (size_t)n;
+	}
+#ifndef SB_HAVE_PREAD
+	if (saved >= 0) {
+		const int err = errno;
+		lseek(in_fd, saved, SEEK_SET);
+		errno = err;
+	}
+#endif // SB_HAVE_PREAD
+	return result < 0 ? -1 : (ssize_t)total;
+}
+
+ssize_t sb_sendfile(string_builder *sb, int in_fd, off_t *offset, size_t count) {
+	if (sb == NULL || sb->sink == NULL || sb->sink->fd < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!sb_flush(sb)) { return -1; }
+	size_t total = 0;
+	while (total < count) {
+		ssize_t n = sendfile(sb->sink->fd, in_fd, offset, count - total);
+		if (n < 0) {
+			if (errno == EINTR) { continue; }
+			if (total == 0 && (errno == EINVAL || errno == ENOSYS)) {
+				return sb_copy_fd(sb->sink->fd, in_fd, offset, count);
+			}
+			return -1;
+		}
+		if (n == 0) { break; }
+		total += (size_t)n;
+	}
+	return (ssize_t)total;
+}
+
+ssize_t sb_splice(string_builder *sb, int in_fd, size_t count) {
+	if (sb == NULL || sb->sink == NULL || sb->sink->fd < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!sb_flush(sb)) { return -1; }
+#ifdef SPLICE_F_MOVE
+	size_t total = 0;
+	while (total < count) {
+		ssize_t n = splice(in_fd, NULL, sb->sink->fd, NULL, count - total, SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (n < 0) {
+			if (errno == EINTR) { continue; }
+			return -1;
+		}
+		if (n == 0) { break; }
+		total += (size_t)n;
+	}
+	return (ssize_t)total;
+#else
+	// `splice` is only declared with _GNU_SOURCE.
+	return sb_copy_fd(sb->sink->fd, in_fd, NULL, count);
+#endif // SPLICE_F_MOVE
+}
+#endif // __linux__
+
 void sb_deinit(string_builder *sb) {
 	if (sb == NULL) { return; }
-	free(sb->buf);
+#ifdef SB_STATS
+	if (sb->buf != NULL) {
+		sb_stats_retire(sb);
+	}
+#endif // SB_STATS
+	if (sb->buf != NULL) {
+		sb_span span = {
+			.ptr = sb->buf,
+			.cap = sb->cap,
+			.flags = sb->flags & SB_MMAP,
+			.alloc = sb->alloc,
+			.alloc_ctx = sb->alloc_ctx,
+		};
+		if (!(sb->flags & SB_INLINE)) {
+			sb_span_free(&span);
+		}
+	}
+	sb->buf = NULL;
 	sb->cap = 0;
 	sb->len = 0;
+	sb->flags = 0;
 }
 
 size_t sb_write(string_builder *sb, const char *s) {
 	if (sb == NULL || s == NULL) { return 0; }
-	return sb_writef(sb, "%s", s);
+	return sb_writen(sb, s, strlen(s));
+}
+
+size_t sb_writen(string_builder *sb, const char *s, size_t n) {
+	if (sb == NULL || s == NULL) { return 0; }
+	// Writes that would not fit a bounded builder even when empty bypass it.
+	if (sb->sink != NULL && n >= sb->cap) {
+		if (!sb_flush(sb) || !sb->sink->write(sb->sink, s, n)) {
+			return 0;
+		}
+		if (sb->hash != NULL) {
+			sb_hash_update(sb->hash, s, n);
+		}
+		return n;
+	}
+	char *dst = sb_reserve(sb, n);
+	if (dst == NULL) {
+		return 0;
+	}
+	memcpy(dst, s, n);
+	sb_advance(sb, n);
+	return n;
 }
 
 size_t sb_writef(string_builder *sb, const char *format, ...) {
@@ -136,42 +963,386 @@ size_t sb_vwritef(string_builder *sb, const char *format, va_list args) {
 	va_copy(args_copy, args);
 	const int len = vsnprintf(NULL, 0, format, args_copy);
 	va_end(args_copy);
+	SB_STAT(sb, vsnprintf, 1);
 	if (len < 0) {
 		return 0;
 	}
-	size_t min_cap = sb->len+len+1;
-	if (min_cap >= sb->cap) {
-		if (!sb_grow(sb, min_cap)) {
-			return 0;
-		}
+	char *dst = sb_reserve(sb, len);
+	if (dst == NULL) {
+		return 0;
 	}
-	char *dst = sb->buf;
-	const int written = vsnprintf(dst + sb->len, len+1, format, args);
+	const int written = vsnprintf(dst, len+1, format, args);
+	SB_STAT(sb, vsnprintf, 1);
 	if (written < 0) {
 		return 0;
 	}
-	sb->len += written;
+	sb_advance(sb, written);
 	return written;
 }
 
 void sb_clear(string_builder *sb) {
 	if (sb == NULL || sb->buf == NULL) { return; }
-	memset(sb->buf, 0, sb->cap);
+	if (!(sb->flags & SB_NOZERO)) {
+		memset(sb->buf, 0, sb->cap);
+		SB_STAT(sb, zeroed, sb->cap);
+	}
 	sb->len = 0;
 	if (sb->cap > 0) {
 		sb->buf[0] = 0;
 	}
+	if (sb->hash != NULL) {
+		sb_hash_reset(sb->hash, sb->hash->seed);
+	}
 }
 
 bool sb_grow(string_builder *sb, const size_t size) {
 	if (sb == NULL || size == 0) { return false; }
 	size_t new_cap = size;
 	if (new_cap < sb->cap) { return false; }
-	char *buf = realloc(sb->buf, new_cap);
-	if (buf == NULL) { return false; }
-	memset(buf + sb->len, 0, new_cap - sb->len);
+	char *buf;
+	if (sb->flags & SB_INLINE) {
+		buf = (char *)malloc(new_cap);
+		if (buf == NULL) { return false; }
+		memcpy(buf, sb->buf, sb->len + 1);
+		SB_STAT(sb, grow_copied, sb->len + 1);
+		sb->flags &= ~SB_INLINE;
+	} else if (sb->flags & SB_MMAP) {
+		new_cap = sb_page_round(new_cap);
+		buf = sb->buf != NULL ? sb_mremap(sb, new_cap) : sb_mmap(new_cap, sb->flags);
+		if (buf == NULL) { return false; }
+		// Pages added by the mapping are already zero.
+		sb->buf = buf;
+		sb->cap = new_cap;
+		SB_STAT(sb, grows, 1);
+		return true;
+	} else {
+		buf = sb->alloc != NULL
+			? (char *)sb->alloc->realloc(sb->alloc_ctx, sb->buf, sb->cap, new_cap)
+			: (char *)realloc(sb->buf, new_cap);
+		if (buf == NULL) { return false; }
+		if (buf != sb->buf && sb->buf != NULL) {
+			// The allocation moved, so its old contents were copied.
+			SB_STAT(sb, grow_copied, sb->cap);
+		}
+	}
+	if (!(sb->flags & SB_NOZERO)) {
+		memset(buf + sb->len, 0, new_cap - sb->len);
+		SB_STAT(sb, zeroed, new_cap - sb->len);
+	} else {
+		buf[sb->len] = 0;
+	}
 	sb->buf = buf;
 	sb->cap = new_cap;
+	SB_STAT(sb, grows, 1);
+	return true;
+}
+
+// Grows the buffer to fit `n` more bytes and the terminator without flushing.
+static bool sb_make_room(string_builder *sb, const size_t n) {
+	const size_t min_cap = sb->len + n + 1;
+	if (min_cap <= sb->cap) { return true; }
+	size_t new_cap = sb->cap * 2;
+	if (sb->sink != NULL || new_cap < min_cap) {
+		new_cap = min_cap;
+	}
+	// Fall back to the exact size if doubling does not fit.
+	return sb_grow(sb, new_cap) || (new_cap != min_cap && sb_grow(sb, min_cap));
+}
+
+char *sb_reserve(string_builder *sb, const size_t n) {
+	if (sb == NULL) { return NULL; }
+	if (sb->len + n >= sb->cap) {
+		if (sb->sink != NULL) {
+			if (!sb_flush(sb)) { return NULL; }
+		}
+		if (!sb_make_room(sb, n)) { return NULL; }
+	}
+	return sb->buf + sb->len;
+}
+
+void sb_advance(string_builder *sb, const size_t n) {
+	sb->len += n;
+	sb->buf[sb->len] = 0;
+	if (sb->hash != NULL && sb->len - sb->hash->pos >= SB_HASH_LAG) {
+		sb_hash_catch_up(sb);
+	}
+}
+
+// Finds `needle` in `hay`. Candidates are positions where both the first and
+// the last byte of the needle match, which SSE2 tests 16 positions at a time.
+static const char *sb_memfind(const char *hay, const size_t hay_n, const char *needle, const size_t n) {
+	if (n == 0) { return hay; }
+	if (n > hay_n) { return NULL; }
+	if (n == 1) { return (const char *)memchr(hay, needle[0], hay_n); }
+#ifdef SB_HAVE_MEMMEM
+	// Two-way search keeps long, self-similar needles linear.
+	if (n > 32) { return (const char *)memmem(hay, hay_n, needle, n); }
+#endif // SB_HAVE_MEMMEM
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[n-1]);
+	for (; i + n - 1 + 16 <= hay_n; i += 16) {
+		const __m128i f = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(hay + i)));
+		const __m128i l = _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(hay + i + n - 1)));
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(f, l));
+		while (mask != 0) {
+			const unsigned bit = (unsigned)__builtin_ctz(mask);
+			if (memcmp(hay + i + bit + 1, needle + 1, n - 2) == 0) {
+				return hay + i + bit;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif // __SSE2__
+	for (; i + n <= hay_n; i++) {
+		const char *p = (const char *)memchr(hay + i, needle[0], hay_n - n + 1 - i);
+		if (p == NULL) { return NULL; }
+		i = (size_t)(p - hay);
+		if (p[n-1] == needle[n-1] && memcmp(p + 1, needle + 1, n - 2) == 0) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+ssize_t sb_find(const string_builder *sb, size_t from, const char *needle, size_t n) {
+	if (sb == NULL || sb->buf == NULL || needle == NULL || from > sb->len) { return -1; }
+	const char *p = sb_memfind(sb->buf + from, sb->len - from, needle, n);
+	return p != NULL ? (ssize_t)(p - sb->buf) : -1;
+}
+
+bool sb_insert(string_builder *sb, size_t pos, const char *s, size_t n) {
+	if (sb == NULL || s == NULL || pos > sb->len) { return false; }
+	if (n == 0) { return true; }
+	// Keep track of a source inside the buffer across growing and shifting.
+	const bool inside = sb->buf != NULL && s >= sb->buf && s < sb->buf + sb->len;
+	const size_t s_off = inside ? (size_t)(s - sb->buf) : 0;
+	if (!sb_make_room(sb, n)) { return false; }
+	char *at = sb->buf + pos;
+	memmove(at + n, at, sb->len - pos);
+	if (!inside) {
+		memcpy(at, s, n);
+	} else {
+		// The part of the source behind `pos` has moved back by `n` bytes.
+		const size_t head = s_off < pos ? (pos - s_off < n ? pos - s_off : n) : 0;
+		memcpy(at, sb->buf + s_off, head);
+		memcpy(at + head, sb->buf + s_off + head + n, n - head);
+	}
+	sb->len += n;
+	sb->buf[sb->len] = 0;
+	sb_hash_sync(sb);
+	return true;
+}
+
+size_t sb_erase(string_builder *sb, size_t pos, size_t n) {
+	if (sb == NULL || sb->buf == NULL || pos >= sb->len) { return 0; }
+	if (n > sb->len - pos) { n = sb->len - pos; }
+	memmove(sb->buf + pos, sb->buf + pos + n, sb->len - pos - n);
+	sb->len -= n;
+	if (!(sb->flags & SB_NOZERO)) {
+		memset(sb->buf + sb->len, 0, n);
+	}
+	sb->buf[sb->len] = 0;
+	sb_hash_sync(sb);
+	return n;
+}
+
+size_t sb_replace_all(string_builder *sb, const char *from, size_t from_n, const char *to, size_t to_n) {
+	if (sb == NULL || sb->buf == NULL || from == NULL || from_n == 0 || (to == NULL && to_n > 0)) { return 0; }
+	size_t count = 0;
+	for (const char *p = sb->buf, *end = sb->buf + sb->len; (p = sb_memfind(p, (size_t)(end - p), from, from_n)) != NULL; p += from_n) {
+		count++;
+	}
+	if (count == 0) { return 0; }
+	const size_t old_len = sb->len;
+	size_t src = 0; // Where the unprocessed contents start.
+	if (to_n > from_n) {
+		// Grow once, then move the contents to the end of the new length so
+		// the forward pass below never overwrites bytes it has yet to read.
+		const size_t shift = count * (to_n - from_n);
+		if (!sb_make_room(sb, shift)) { return 0; }
+		memmove(sb->buf + shift, sb->buf, old_len);
+		src = shift;
+	}
+	const size_t src_end = src + old_len;
+	size_t dst = 0;
+	for (size_t i = 0; i < count; i++) {
+		const char *p = sb_memfind(sb->buf + src, src_end - src, from, from_n);
+		const size_t keep = (size_t)(p - (sb->buf + src));
+		memmove(sb->buf + dst, sb->buf + src, keep);
+		dst += keep;
+		memcpy(sb->buf + dst, to, to_n);
+		dst += to_n;
+		src += keep + from_n;
+	}
+	memmove(sb->buf + dst, sb->buf + src, src_end - src);
+	dst += src_end - src;
+	sb->len = dst;
+	if (dst < old_len && !(sb->flags & SB_NOZERO)) {
+		memset(sb->buf + dst, 0, old_len - dst);
+	}
+	sb->buf[dst] = 0;
+	sb_hash_sync(sb);
+	return count;
+}
+
+#define SB_XXH_P1 UINT64_C(0x9E3779B185EBCA87)
+#define SB_XXH_P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define SB_XXH_P3 UINT64_C(0x165667B19E3779F9)
+#define SB_XXH_P4 UINT64_C(0x85EBCA77C2B2AE63)
+#define SB_XXH_P5 UINT64_C(0x27D4EB2F165667C5)
+
+static inline uint64_t sb_xxh_rotl(const uint64_t x, const int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t sb_xxh_read64(const unsigned char *p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif // big endian
+	return v;
+}
+
+static inline uint32_t sb_xxh_read32(const unsigned char *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif // big endian
+	return v;
+}
+
+static inline uint64_t sb_xxh_round(uint64_t acc, const uint64_t in) {
+	acc += in * SB_XXH_P2;
+	return sb_xxh_rotl(acc, 31) * SB_XXH_P1;
+}
+
+void sb_hash_reset(sb_hash *h, uint64_t seed) {
+	h->v[0] = seed + SB_XXH_P1 + SB_XXH_P2;
+	h->v[1] = seed + SB_XXH_P2;
+	h->v[2] = seed;
+	h->v[3] = seed - SB_XXH_P1;
+	h->total = 0;
+	h->seed = seed;
+	h->mem_len = 0;
+	h->pos = 0;
+}
+
+void sb_hash_update(sb_hash *h, const char *s, size_t n) {
+	if (n == 0) { return; }
+	const unsigned char *p = (const unsigned char *)s;
+	h->total += n;
+	if (h->mem_len + n < 32) {
+		memcpy(h->mem + h->mem_len, p, n);
+		h->mem_len += (unsigned)n;
+		return;
+	}
+	uint64_t v0 = h->v[0], v1 = h->v[1], v2 = h->v[2], v3 = h->v[3];
+	if (h->mem_len > 0) {
+		const size_t fill = 32 - h->mem_len;
+		memcpy(h->mem + h->mem_len, p, fill);
+		v0 = sb_xxh_round(v0, sb_xxh_read64(h->mem));
+		v1 = sb_xxh_round(v1, sb_xxh_read64(h->mem + 8));
+		v2 = sb_xxh_round(v2, sb_xxh_read64(h->mem + 16));
+		v3 = sb_xxh_round(v3, sb_xxh_read64(h->mem + 24));
+		p += fill;
+		n -= fill;
+		h->mem_len = 0;
+	}
+	for (; n >= 32; p += 32, n -= 32) {
+		v0 = sb_xxh_round(v0, sb_xxh_read64(p));
+		v1 = sb_xxh_round(v1, sb_xxh_read64(p + 8));
+		v2 = sb_xxh_round(v2, sb_xxh_read64(p + 16));
+		v3 = sb_xxh_round(v3, sb_xxh_read64(p + 24));
+	}
+	h->v[0] = v0;
+	h->v[1] = v1;
+	h->v[2] = v2;
+	h->v[3] = v3;
+	memcpy(h->mem, p, n);
+	h->mem_len = (unsigned)n;
+}
+
+uint64_t sb_hash_digest(const sb_hash *h) {
+	uint64_t acc;
+	if (h->total >= 32) {
+		acc = sb_xxh_rotl(h->v[0], 1) + sb_xxh_rotl(h->v[1], 7) + sb_xxh_rotl(h->v[2], 12) + sb_xxh_rotl(h->v[3], 18);
+		for (int i = 0; i < 4; i++) {
+			acc = (acc ^ sb_xxh_round(0, h->v[i])) * SB_XXH_P1 + SB_XXH_P4;
+		}
+	} else {
+		acc = h->seed + SB_XXH_P5;
+	}
+	acc += h->total;
+	const unsigned char *p = h->mem;
+	size_t n = h->mem_len;
+	for (; n >= 8; p += 8, n -= 8) {
+		acc ^= sb_xxh_round(0, sb_xxh_read64(p));
+		acc = sb_xxh_rotl(acc, 27) * SB_XXH_P1 + SB_XXH_P4;
+	}
+	if (n >= 4) {
+		acc ^= (uint64_t)sb_xxh_read32(p) * SB_XXH_P1;
+		acc = sb_xxh_rotl(acc, 23) * SB_XXH_P2 + SB_XXH_P3;
+		p += 4;
+		n -= 4;
+	}
+	for (; n > 0; p++, n--) {
+		acc ^= *p * SB_XXH_P5;
+		acc = sb_xxh_rotl(acc, 11) * SB_XXH_P1;
+	}
+	acc ^= acc >> 33;
+	acc *= SB_XXH_P2;
+	acc ^= acc >> 29;
+	acc *= SB_XXH_P3;
+	acc ^= acc >> 32;
+	return acc;
+}
+
+void sb_hash_enable(string_builder *sb, sb_hash *h, uint64_t seed) {
+	if (sb == NULL) { return; }
+	sb->hash = h;
+	if (h != NULL) {
+		sb_hash_reset(h, seed);
+		sb_hash_catch_up(sb);
+	}
+}
+
+uint64_t sb_digest(string_builder *sb) {
+	sb_hash_catch_up(sb);
+	return sb_hash_digest(sb->hash);
+}
+
+void sb_hash_sync(string_builder *sb) {
+	if (sb == NULL || sb->hash == NULL) { return; }
+	sb_hash_reset(sb->hash, sb->hash->seed);
+	sb_hash_catch_up(sb);
+}
+
+sb_mark sb_snapshot(string_builder *sb) {
+	sb_mark m = {0};
+	m.len = sb->len;
+	if (sb->hash != NULL) {
+		sb_hash_catch_up(sb);
+		m.hash = *sb->hash;
+	}
+	return m;
+}
+
+bool sb_rollback(string_builder *sb, const sb_mark *m) {
+	if (sb == NULL || m->len > sb->len) { return false; }
+	if (sb->buf != NULL) {
+		if (!(sb->flags & SB_NOZERO)) {
+			memset(sb->buf + m->len, 0, sb->len - m->len);
+		}
+		sb->buf[m->len] = 0;
+	}
+	sb->len = m->len;
+	if (sb->hash != NULL) {
+		*sb->hash = m->hash;
+	}
 	return true;
 }
 
@@ -181,6 +1352,117 @@ char *sb_to_string(const string_builder *sb) {
 	return s;
 }
 
+sb_span sb_detach(string_builder *sb, bool shrink) {
+	sb_span span = {0};
+	if (sb == NULL || sb->buf == NULL) { return span; }
+#ifdef SB_STATS
+	sb_stats_retire(sb);
+#endif // SB_STATS
+	if (sb->flags & SB_INLINE) {
+		span.ptr = (char *)malloc(sb->len + 1);
+		if (span.ptr == NULL) { return span; }
+		memcpy(span.ptr, sb->buf, sb->len + 1);
+		span.len = sb->len;
+		span.cap = sb->len + 1;
+		memset(sb->buf, 0, sb->len);
+		sb->len = 0;
+		sb_hash_sync(sb);
+		return span;
+	}
+	size_t cap = sb->cap;
+	if (shrink && sb->len + 1 < cap) {
+		if (sb->flags & SB_MMAP) {
+			const size_t fit = sb_page_round(sb->len + 1);
+			if (fit < cap && munmap(sb->buf + fit, cap - fit) == 0) {
+				cap = fit;
+			}
+		} else {
+			// A failed shrink keeps the original buffer.
+			char *buf = sb->alloc != NULL
+				? (char *)sb->alloc->realloc(sb->alloc_ctx, sb->buf, cap, sb->len + 1)
+				: (char *)realloc(sb->buf, sb->len + 1);
+			if (buf != NULL) {
+				sb->buf = buf;
+				cap = sb->len + 1;
+			}
+		}
+	}
+	span.ptr = sb->buf;
+	span.len = sb->len;
+	span.cap = cap;
+	span.flags = sb->flags & SB_MMAP;
+	span.alloc = sb->alloc;
+	span.alloc_ctx = sb->alloc_ctx;
+	sb->buf = NULL;
+	sb->cap = 0;
+	sb->len = 0;
+	sb_hash_sync(sb);
+	return span;
+}
+
+void sb_span_free(sb_span *span) {
+	if (span == NULL || span->ptr == NULL) { return; }
+	if (span->flags & SB_MMAP) {
+		munmap(span->ptr, span->cap);
+	} else if (span->alloc != NULL) {
+		if (span->alloc->free != NULL) {
+			span->alloc->free(span->alloc_ctx, span->ptr, span->cap);
+		}
+	} else {
+		free(span->ptr);
+	}
+	span->ptr = NULL;
+	span->len = 0;
+	span->cap = 0;
+}
+
+#ifdef SB_STATS
+static sb_stats sb_stats_all;
+
+sb_stats sb_stats_get(const string_builder *sb) {
+	sb_stats st = sb->stats;
+	st.finished = 0;
+	st.final_len = sb->len;
+	st.final_cap = sb->cap;
+	return st;
+}
+
+sb_stats sb_stats_global(void) {
+	sb_stats st;
+	st.grows = __atomic_load_n(&sb_stats_all.grows, __ATOMIC_RELAXED);
+	st.grow_copied = __atomic_load_n(&sb_stats_all.grow_copied, __ATOMIC_RELAXED);
+	st.zeroed = __atomic_load_n(&sb_stats_all.zeroed, __ATOMIC_RELAXED);
+	st.vsnprintf = __atomic_load_n(&sb_stats_all.vsnprintf, __ATOMIC_RELAXED);
+	st.finished = __atomic_load_n(&sb_stats_all.finished, __ATOMIC_RELAXED);
+	st.final_len = __atomic_load_n(&sb_stats_all.final_len, __ATOMIC_RELAXED);
+	st.final_cap = __atomic_load_n(&sb_stats_all.final_cap, __ATOMIC_RELAXED);
+	return st;
+}
+
+void sb_stats_reset_global(void) {
+	__atomic_store_n(&sb_stats_all.grows, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sb_stats_all.grow_copied, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sb_stats_all.zeroed, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sb_stats_all.vsnprintf, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sb_stats_all.finished, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sb_stats_all.final_len, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sb_stats_all.final_cap, 0, __ATOMIC_RELAXED);
+}
+
+void sb_stats_retire(string_builder *sb) {
+	// Builders count locally and publish once, so appends never touch
+	// shared cache lines.
+	__atomic_fetch_add(&sb_stats_all.grows, sb->stats.grows, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sb_stats_all.grow_copied, sb->stats.grow_copied, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sb_stats_all.zeroed, sb->stats.zeroed, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sb_stats_all.vsnprintf, sb->stats.vsnprintf, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sb_stats_all.finished, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sb_stats_all.final_len, (uint64_t)sb->len, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sb_stats_all.final_cap, (uint64_t)sb->cap, __ATOMIC_RELAXED);
+	memset(&sb->stats, 0, sizeof(sb->stats));
+}
+#endif // SB_STATS
+
 #endif // SB_IMPLEMENTATION
 
 #endif // SB_H
@@ -0,0 +1,452 @@
+#ifndef SB_HPP
+#define SB_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "sb.h"
+
+// Formatting uses `std::format` when the standard library provides it and
+// falls back to {fmt} otherwise. `SB_FMT` names the namespace in use.
+#if __has_include(<format>)
+#include <format>
+#endif // __has_include(<format>)
+
+#if defined(__cpp_lib_format)
+#define SB_FMT std
+#elif __has_include(<fmt/format.h>)
+#include <fmt/format.h>
+#define SB_FMT fmt
+#else
+#error "sb.hpp requires <format> or {fmt}"
+#endif // __cpp_lib_format
+
+/**
+ * Gets a view of the string builder's contents. The view is invalidated by the
+ * next write.
+ * @param sb String builder.
+ * @return The string builder's contents.
+ */
+inline std::string_view sb_view(const string_builder &sb) noexcept {
+	return std::string_view(sb.buf != nullptr ? sb.buf : "", sb.len);
+}
+
+/**
+ * Gets a view of a slice.
+ * @param s Slice.
+ * @return The slice's bytes.
+ */
+inline std::string_view sb_view(sb_slice s) noexcept {
+	return std::string_view(s.ptr != nullptr ? s.ptr : "", s.len);
+}
+
+/**
+ * Output iterator that appends each assigned character to a string builder,
+ * so that e.g. `std::format_to` writes straight into its buffer.
+ */
+class sb_back_insert_iterator {
+public:
+	using iterator_category = std::output_iterator_tag;
+	using value_type = void;
+	using difference_type = std::ptrdiff_t;
+	using pointer = void;
+	using reference = void;
+
+	explicit sb_back_insert_iterator(string_builder &sb) noexcept : sb_(&sb) {}
+
+	sb_back_insert_iterator &operator=(char c) {
+		char *dst = sb_reserve(sb_, 1);
+		if (dst != nullptr) {
+			*dst = c;
+			sb_advance(sb_, 1);
+		}
+		return *this;
+	}
+
+	sb_back_insert_iterator &operator*() noexcept { return *this; }
+	sb_back_insert_iterator &operator++() noexcept { return *this; }
+	sb_back_insert_iterator &operator++(int) noexcept { return *this; }
+
+private:
+	string_builder *sb_; // The string builder to append to.
+};
+
+/**
+ * Creates an output iterator that appends to a string builder.
+ * @param sb String builder.
+ * @return The output iterator.
+ */
+inline sb_back_insert_iterator sb_back_inserter(string_builder &sb) noexcept {
+	return sb_back_insert_iterator(sb);
+}
+
+/**
+ * Writes a formatted string to the string builder's internal buffer. The
+ * format string is checked at compile time. The output is formatted straight
+ * into the spare capacity; only if it does not fit is the buffer grown once
+ * to the exact size and the output formatted again.
+ * @param sb   String builder.
+ * @param fmt  The format string.
+ * @param args The arguments.
+ * @return The number of bytes written.
+ */
+template <typename... Args>
+size_t sb_format_to(string_builder &sb, SB_FMT::format_string<const Args &...> fmt, const Args &...args) {
+	size_t n;
+	const size_t room = sb.buf != nullptr && sb.cap > sb.len ? sb.cap - sb.len - 1 : 0;
+	if (room > 0) {
+		auto res = SB_FMT::format_to_n(sb.buf + sb.len, room, fmt, args...);
+		n = static_cast<size_t>(res.size);
+		if (n <= room) {
+			sb_advance(&sb, n);
+			return n;
+		}
+		// The partial output overwrote the terminator and the zeroed tail;
+		// restore them in case flushing or growing fails.
+		if (sb.flags & SB_NOZERO) {
+			sb.buf[sb.len] = 0;
+		} else {
+			std::memset(sb.buf + sb.len, 0, room);
+		}
+	} else {
+		n = SB_FMT::formatted_size(fmt, args...);
+	}
+	char *dst = sb_reserve(&sb, n);
+	if (dst == nullptr) {
+		return 0;
+	}
+	SB_FMT::format_to(dst, fmt, args...);
+	sb_advance(&sb, n);
+	return n;
+}
+
+/**
+ * Concatenation piece for a string literal, whose length is part of its type;
+ * see `sb_lit`.
+ */
+template <size_t N>
+struct sb_lit_piece {
+	const char *ptr; // The literal.
+
+	static constexpr size_t size() noexcept { return N - 1; }
+	char *copy(char *dst) const noexcept {
+		std::memcpy(dst, ptr, N - 1);
+		return dst + N - 1;
+	}
+	static constexpr bool aliases(const char *, size_t) noexcept { return false; }
+	void rebase(const char *, size_t, const char *) noexcept {}
+};
+
+/**
+ * Concatenation piece for a string whose length is known at run time.
+ */
+struct sb_str_piece {
+	const char *ptr; // The first byte.
+	size_t len;      // The number of bytes.
+
+	size_t size() const noexcept { return len; }
+	char *copy(char *dst) const noexcept {
+		std::memcpy(dst, ptr, len);
+		return dst + len;
+	}
+	// Whether the bytes are inside `buf`, e.g. a builder appended to itself.
+	bool aliases(const char *buf, size_t buf_len) const noexcept {
+		const uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+		const uintptr_t b = reinterpret_cast<uintptr_t>(buf);
+		return len > 0 && buf != nullptr && p >= b && p < b + buf_len;
+	}
+	// Follows bytes inside `old` to where they were moved.
+	void rebase(const char *old, size_t old_len, const char *buf) noexcept {
+		if (aliases(old, old_len)) {
+			ptr = buf + (ptr - old);
+		}
+	}
+};
+
+/**
+ * Concatenation piece for a single character.
+ */
+struct sb_char_piece {
+	char c; // The character.
+
+	static constexpr size_t size() noexcept { return 1; }
+	char *copy(char *dst) const noexcept {
+		*dst = c;
+		return dst + 1;
+	}
+	static constexpr bool aliases(const char *, size_t) noexcept { return false; }
+	void rebase(const char *, size_t, const char *) noexcept {}
+};
+
+/**
+ * Makes a concatenation piece of a string literal without measuring it at run
+ * time, e.g. `sb_write_cat(sb, sb_lit("id="), id)`. The whole array but its
+ * terminator is copied, so only pass literals.
+ * @param s The literal.
+ * @return The piece.
+ */
+template <size_t N>
+constexpr sb_lit_piece<N> sb_lit(const char (&s)[N]) noexcept { return {s}; }
+
+// Arrays are measured up to their first NUL, so a buffer holding a shorter
+// string is not copied whole; compilers fold this for literals.
+template <size_t N>
+inline sb_str_piece sb_to_piece(const char (&s)[N]) noexcept { return {s, strnlen(s, N)}; }
+template <typename T, typename = std::enable_if_t<std::is_same_v<T, const char *> || std::is_same_v<T, char *>>>
+inline sb_str_piece sb_to_piece(const T &s) noexcept { return {s, std::strlen(s)}; }
+inline sb_str_piece sb_to_piece(std::string_view s) noexcept { return {s.data(), s.size()}; }
+inline sb_str_piece sb_to_piece(const std::string &s) noexcept { return {s.data(), s.size()}; }
+inline sb_str_piece sb_to_piece(sb_slice s) noexcept { return {s.ptr, s.len}; }
+inline sb_str_piece sb_to_piece(const string_builder &sb) noexcept { return {sb.buf, sb.len}; }
+template <typename T, typename = std::enable_if_t<std::is_same_v<T, char>>>
+constexpr sb_char_piece sb_to_piece(T c) noexcept { return {c}; }
+// Numbers are not characters; format them with `sb_format_to` instead.
+template <typename T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, char>, int> = 0>
+void sb_to_piece(T) = delete;
+template <size_t N>
+constexpr sb_lit_piece<N> sb_to_piece(sb_lit_piece<N> p) noexcept { return p; }
+inline sb_str_piece sb_to_piece(sb_str_piece p) noexcept { return p; }
+constexpr sb_char_piece sb_to_piece(sb_char_piece p) noexcept { return p; }
+
+template <typename T>
+using sb_piece_t = decltype(sb_to_piece(std::declval<T>()));
+
+/**
+ * Lazy concatenation of pieces. Nothing is copied until the expression is
+ * appended, at which point the total length is computed once, space is
+ * reserved once and each piece is copied with a single `memcpy`. Pieces refer
+ * to their source strings, so the expression must be used while they live.
+ */
+template <typename... Pieces>
+struct sb_cat_expr {
+	std::tuple<Pieces...> pieces; // The pieces, in order.
+
+	size_t size() const noexcept {
+		return std::apply([](const auto &...p) { return (size_t{0} + ... + p.size()); }, pieces);
+	}
+
+	char *copy(char *dst) const noexcept {
+		std::apply([&dst](const auto &...p) { ((dst = p.copy(dst)), ...); }, pieces);
+		return dst;
+	}
+
+	bool aliases(const char *buf, size_t len) const noexcept {
+		return std::apply([&](const auto &...p) { return (false || ... || p.aliases(buf, len)); }, pieces);
+	}
+
+	void rebase(const char *old, size_t old_len, const char *buf) noexcept {
+		std::apply([&](auto &...p) { (p.rebase(old, old_len, buf), ...); }, pieces);
+	}
+};
+
+/**
+ * Builds a concatenation expression from string literals, C strings,
+ * `std::string`, `std::string_view`, slices, string builders and characters.
+ * @param ts The pieces.
+ * @return The concatenation expression.
+ */
+template <typename... Ts>
+sb_cat_expr<sb_piece_t<Ts>...> sb_cat(Ts &&...ts) {
+	return {std::tuple<sb_piece_t<Ts>...>(sb_to_piece(ts)...)};
+}
+
+template <typename T>
+struct sb_is_cat_expr : std::false_type {};
+template <typename... Pieces>
+struct sb_is_cat_expr<sb_cat_expr<Pieces...>> : std::true_type {};
+
+/**
+ * Extends a concatenation expression with one more piece.
+ */
+template <typename... Pieces, typename T>
+sb_cat_expr<Pieces..., sb_piece_t<T>> operator+(const sb_cat_expr<Pieces...> &e, T &&t) {
+	return {std::tuple_cat(e.pieces, std::tuple<sb_piece_t<T>>(sb_to_piece(t)))};
+}
+
+/**
+ * Appends a concatenation expression to the string builder.
+ * @param sb String builder.
+ * @param e  The concatenation expression.
+ * @return The number of bytes written.
+ */
+template <typename... Pieces>
+size_t sb_append(string_builder &sb, const sb_cat_expr<Pieces...> &e) {
+	const size_t n = e.size();
+	if (e.aliases(sb.buf, sb.len)) {
+		// A piece is the builder's own contents, which neither growing nor
+		// flushing may invalidate: grow in place and follow the move.
+		sb_cat_expr<Pieces...> moved = e;
+		const char *old = sb.buf;
+		if (sb.len + n >= sb.cap && !sb_grow(&sb, sb.len + n + 1)) {
+			return 0;
+		}
+		moved.rebase(old, sb.len, sb.buf);
+		moved.copy(sb.buf + sb.len);
+		sb_advance(&sb, n);
+		return n;
+	}
+	char *dst = sb_reserve(&sb, n);
+	if (dst == nullptr) {
+		return 0;
+	}
+	e.copy(dst);
+	sb_advance(&sb, n);
+	return n;
+}
+
+/**
+ * Appends the concatenation of the pieces to the string builder, e.g.
+ * `sb_write_cat(sb, key, ": ", value, '\n')`.
+ * @param sb String builder.
+ * @param ts The pieces.
+ * @return The number of bytes written.
+ */
+template <typename... Ts>
+size_t sb_write_cat(string_builder &sb, Ts &&...ts) {
+	return sb_append(sb, sb_cat(ts...));
+}
+
+#ifdef ARENA_H
+/**
+ * Allocates the null-terminated concatenation of the pieces from an arena.
+ * Requires `arena.h` to be included before `sb.hpp`.
+ * @param a  Arena pointer.
+ * @param ts The pieces, or a single concatenation expression.
+ * @return The concatenated string, or `NULL` if the arena is full.
+ */
+template <typename... Pieces>
+char *arena_cat(arena *a, const sb_cat_expr<Pieces...> &e) {
+	const size_t n = e.size();
+	char *dst = static_cast<char *>(arena_alloc(a, n + 1));
+	if (dst == nullptr) {
+		return nullptr;
+	}
+	*e.copy(dst) = '\0';
+	return dst;
+}
+
+template <typename... Ts>
+	requires (!(sizeof...(Ts) == 1 && (sb_is_cat_expr<std::remove_cvref_t<Ts>>::value && ...)))
+char *arena_cat(arena *a, Ts &&...ts) {
+	return arena_cat(a, sb_cat(ts...));
+}
+#endif // ARENA_H
+
+/**
+ * Move-only owner of a string builder. Moving transfers the buffer without
+ * copying it (inline contents are at most `SB_SSO_CAP` bytes), and `clone`
+ * makes the only kind of deep copy.
+ */
+class unique_string_builder {
+public:
+	/**
+	 * Creates a builder that starts with inline storage and does not allocate
+	 * until its contents outgrow `SB_SSO_CAP` bytes.
+	 */
+	unique_string_builder() noexcept { sb_init_sso(&small_); }
+
+	/**
+	 * Creates a builder with a specific capacity and flags (`SB_*`).
+	 */
+	explicit unique_string_builder(size_t cap, unsigned flags = 0) noexcept {
+		sb_init_flags(&small_.sb, cap, flags);
+	}
+
+	unique_string_builder(const unique_string_builder &) = delete;
+	unique_string_builder &operator=(const unique_string_builder &) = delete;
+
+	unique_string_builder(unique_string_builder &&other) noexcept { steal(other); }
+
+	unique_string_builder &operator=(unique_string_builder &&other) noexcept {
+		if (this != &other) {
+			sb_deinit(&small_.sb);
+			steal(other);
+		}
+		return *this;
+	}
+
+	~unique_string_builder() { sb_deinit(&small_.sb); }
+
+	/**
+	 * Makes a deep copy with a single allocation sized to the contents.
+	 * Short contents are copied inline without allocating.
+	 */
+	unique_string_builder clone() const {
+		const string_builder &sb = small_.sb;
+		unique_string_builder copy = sb.len < SB_SSO_CAP
+			? unique_string_builder()
+			: unique_string_builder(sb.len + 1, sb.flags & ~SB_INLINE);
+		sb_writen(copy.get(), sb.buf, sb.len);
+		return copy;
+	}
+
+	string_builder *get() noexcept { return &small_.sb; }
+	const string_builder *get() const noexcept { return &small_.sb; }
+	string_builder &operator*() noexcept { return small_.sb; }
+	const string_builder &operator*() const noexcept { return small_.sb; }
+	string_builder *operator->() noexcept { return &small_.sb; }
+	const string_builder *operator->() const noexcept { return &small_.sb; }
+
+	std::string_view view() const noexcept { return sb_view(small_.sb); }
+	const char *c_str() const noexcept { return small_.sb.buf != nullptr ? small_.sb.buf : ""; }
+	size_t size() const noexcept { return small_.sb.len; }
+	bool empty() const noexcept { return small_.sb.len == 0; }
+
+	size_t write(std::string_view s) noexcept { return sb_writen(&small_.sb, s.data(), s.size()); }
+	void clear() noexcept { sb_clear(&small_.sb); }
+	sb_span detach(bool shrink = false) noexcept { return sb_detach(&small_.sb, shrink); }
+
+private:
+	// Takes over `other`'s buffer and leaves `other` empty and inline.
+	void steal(unique_string_builder &other) noexcept {
+		std::memcpy(static_cast<void *>(&small_), &other.small_, sizeof(small_));
+		if (small_.sb.flags & SB_INLINE) {
+			small_.sb.buf = small_.sso;
+		}
+		sb_init_sso(&other.small_);
+	}
+
+	sb_small small_; // The owned string builder and its inline storage.
+};
+
+/**
+ * Formats a string builder's contents like a `std::string_view`.
+ */
+template <>
+struct SB_FMT::formatter<string_builder, char> : SB_FMT::formatter<std::string_view, char> {
+	template <typename FormatContext>
+	auto format(const string_builder &sb, FormatContext &ctx) const {
+		return SB_FMT::formatter<std::string_view, char>::format(sb_view(sb), ctx);
+	}
+};
+
+/**
+ * Formats a slice like a `std::string_view`.
+ */
+template <>
+struct SB_FMT::formatter<sb_slice, char> : SB_FMT::formatter<std::string_view, char> {
+	template <typename FormatContext>
+	auto format(sb_slice s, FormatContext &ctx) const {
+		return SB_FMT::formatter<std::string_view, char>::format(sb_view(s), ctx);
+	}
+};
+
+/**
+ * Formats an owned string builder's contents like a `std::string_view`.
+ */
+template <>
+struct SB_FMT::formatter<unique_string_builder, char> : SB_FMT::formatter<std::string_view, char> {
+	template <typename FormatContext>
+	auto format(const unique_string_builder &sb, FormatContext &ctx) const {
+		return SB_FMT::formatter<std::string_view, char>::format(sb.view(), ctx);
+	}
+};
+
+#endif // SB_HPP
@@ -0,0 +1,261 @@
+#ifndef SB_ASYNC_H
+#define SB_ASYNC_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "sb.h"
+
+#ifndef SB_ASYNC_DEFAULT_CAP
+#define SB_ASYNC_DEFAULT_CAP (64 * 1024)
+#endif // SB_ASYNC_DEFAULT_CAP
+
+/**
+ * Asynchronous writer. Producers fill string builders from a fixed set and
+ * submit them; a background thread writes submitted builders to a file
+ * descriptor in submission order and hands them back for reuse.
+ */
+typedef struct sb_async {
+	int fd;                 // The file descriptor to write to.
+	string_builder *bufs;   // The string builders.
+	size_t n;               // The number of string builders.
+
+	string_builder **free;  // Stack of builders ready to be acquired.
+	size_t free_len;        // The number of builders on the free stack.
+	string_builder **queue; // Ring of submitted builders, oldest first.
+	size_t queue_head;      // Index of the oldest submitted builder.
+	size_t queue_len;       // The number of submitted builders.
+	bool busy;              // Whether the writer thread is writing.
+	bool stop;              // Whether the writer thread should exit.
+	int err;                // The errno of the first failed write, or zero (0).
+
+	pthread_t thread;       // The writer thread.
+	pthread_mutex_t mu;     // Guards the fields above.
+	pthread_cond_t avail;   // Signaled when a builder is returned to `free`.
+	pthread_cond_t work;    // Signaled when a builder is submitted.
+	pthread_cond_t idle;    // Signaled when the queue has been drained.
+} sb_async;
+
+/**
+ * Initializes an asynchronous writer and starts its writer thread.
+ * @param w     Asynchronous writer pointer.
+ * @param fd    The file descriptor to write to.
+ * @param nbufs The number of string builders, at least two (2).
+ * @param cap   The initial capacity of each string builder.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool sb_async_init(sb_async *w, int fd, size_t nbufs, size_t cap);
+
+/**
+ * Writes out every submitted builder, stops the writer thread and frees the
+ * string builders.
+ * @param w Asynchronous writer pointer.
+ * @return `true` if every write succeeded; otherwise, `false`.
+ */
+bool sb_async_deinit(sb_async *w);
+
+/**
+ * Acquires an empty string builder to fill. Blocks while every builder is
+ * submitted or being filled, which applies backpressure to producers.
+ * @param w Asynchronous writer pointer.
+ * @return An empty string builder, owned by the caller until it is submitted.
+ */
+string_builder *sb_async_acquire(sb_async *w);
+
+/**
+ * Submits a string builder from `sb_async_acquire` to be written out.
+ * Builders are written in the order they are submitted.
+ * @param w  Asynchronous writer pointer.
+ * @param sb The string builder to submit.
+ */
+void sb_async_submit(sb_async *w, string_builder *sb);
+
+/**
+ * Waits until every submitted builder has been written out.
+ * @param w Asynchronous writer pointer.
+ * @return `true` if every write so far succeeded; otherwise, `false` and
+ *         `w->err` holds the error.
+ */
+bool sb_async_flush(sb_async *w);
+
+#ifdef SB_ASYNC_IMPLEMENTATION
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef SB_ASYNC_IOV_BATCH
+#define SB_ASYNC_IOV_BATCH 64
+#endif // SB_ASYNC_IOV_BATCH
+
+static bool sb_async_writev(int fd, struct iovec *iov, int n) {
+	while (n > 0) {
+		ssize_t w = writev(fd, iov, n);
+		if (w < 0) {
+			if (errno == EINTR) { continue; }
+			return false;
+		}
+		while (n > 0 && (size_t)w >= iov->iov_len) {
+			w -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char *)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+	}
+	return true;
+}
+
+static void *sb_async_run(void *arg) {
+	sb_async *w = (sb_async *)arg;
+	string_builder *batch[SB_ASYNC_IOV_BATCH];
+	struct iovec iov[SB_ASYNC_IOV_BATCH];
+	pthread_mutex_lock(&w->mu);
+	for (;;) {
+		while (w->queue_len == 0 && !w->stop) {
+			pthread_cond_wait(&w->work, &w->mu);
+		}
+		if (w->queue_len == 0) { break; }
+		// Take everything that is queued and write it with a single writev.
+		int n = 0;
+		while (w->queue_len > 0 && n < SB_ASYNC_IOV_BATCH) {
+			batch[n++] = w->queue[w->queue_head];
+			w->queue_head = (w->queue_head + 1) % w->n;
+			w->queue_len--;
+		}
+		w->busy = true;
+		bool failed = w->err != 0;
+		pthread_mutex_unlock(&w->mu);
+
+		int niov = 0;
+		for (int i = 0; i < n; i++) {
+			if (batch[i]->len == 0) { continue; }
+			iov[niov].iov_base = batch[i]->buf;
+			iov[niov].iov_len = batch[i]->len;
+			niov++;
+		}
+		int err = 0;
+		if (!failed && !sb_async_writev(w->fd, iov, niov)) {
+			err = errno;
+		}
+		for (int i = 0; i < n; i++) {
+			sb_clear(batch[i]);
+		}
+
+		pthread_mutex_lock(&w->mu);
+		if (err != 0 && w->err == 0) {
+			w->err = err;
+		}
+		for (int i = 0; i < n; i++) {
+			w->free[w->free_len++] = batch[i];
+		}
+		w->busy = false;
+		pthread_cond_broadcast(&w->avail);
+		if (w->queue_len == 0) {
+			pthread_cond_broadcast(&w->idle);
+		}
+	}
+	pthread_mutex_unlock(&w->mu);
+	return NULL;
+}
+
+bool sb_async_init(sb_async *w, int fd, size_t nbufs, size_t cap) {
+	nbufs = nbufs >= 2 ? nbufs : 2;
+	w->fd = fd;
+	w->n = nbufs;
+	w->bufs = (string_builder *)calloc(nbufs, sizeof(string_builder));
+	w->free = (string_builder **)calloc(nbufs, sizeof(string_builder *));
+	w->queue = (string_builder **)calloc(nbufs, sizeof(string_builder *));
+	if (w->bufs == NULL || w->free == NULL || w->queue == NULL) {
+		goto fail;
+	}
+	for (size_t i = 0; i < nbufs; i++) {
+		// Only the contents are written out, so clearing a buffer after each
+		// handoff need not zero all of it.
+		sb_init_flags(&w->bufs[i], cap, SB_NOZERO);
+		w->free[i] = &w->bufs[nbufs - 1 - i];
+	}
+	w->free_len = nbufs;
+	w->queue_head = 0;
+	w->queue_len = 0;
+	w->busy = false;
+	w->stop = false;
+	w->err = 0;
+	pthread_mutex_init(&w->mu, NULL);
+	pthread_cond_init(&w->avail, NULL);
+	pthread_cond_init(&w->work, NULL);
+	pthread_cond_init(&w->idle, NULL);
+	if (pthread_create(&w->thread, NULL, sb_async_run, w) != 0) {
+		pthread_mutex_destroy(&w->mu);
+		pthread_cond_destroy(&w->avail);
+		pthread_cond_destroy(&w->work);
+		pthread_cond_destroy(&w->idle);
+		for (size_t i = 0; i < nbufs; i++) {
+			sb_deinit(&w->bufs[i]);
+		}
+		goto fail;
+	}
+	return true;
+fail:
+	free(w->bufs);
+	free(w->free);
+	free(w->queue);
+	w->bufs = NULL;
+	w->free = NULL;
+	w->queue = NULL;
+	return false;
+}
+
+bool sb_async_deinit(sb_async *w) {
+	pthread_mutex_lock(&w->mu);
+	w->stop = true;
+	pthread_cond_signal(&w->work);
+	pthread_mutex_unlock(&w->mu);
+	pthread_join(w->thread, NULL);
+	for (size_t i = 0; i < w->n; i++) {
+		sb_deinit(&w->bufs[i]);
+	}
+	free(w->bufs);
+	free(w->free);
+	free(w->queue);
+	pthread_mutex_destroy(&w->mu);
+	pthread_cond_destroy(&w->avail);
+	pthread_cond_destroy(&w->work);
+	pthread_cond_destroy(&w->idle);
+	return w->err == 0;
+}
+
+string_builder *sb_async_acquire(sb_async *w) {
+	pthread_mutex_lock(&w->mu);
+	while (w->free_len == 0) {
+		pthread_cond_wait(&w->avail, &w->mu);
+	}
+	string_builder *sb = w->free[--w->free_len];
+	pthread_mutex_unlock(&w->mu);
+	return sb;
+}
+
+void sb_async_submit(sb_async *w, string_builder *sb) {
+	pthread_mutex_lock(&w->mu);
+	w->queue[(w->queue_head + w->queue_len) % w->n] = sb;
+	w->queue_len++;
+	pthread_cond_signal(&w->work);
+	pthread_mutex_unlock(&w->mu);
+}
+
+bool sb_async_flush(sb_async *w) {
+	pthread_mutex_lock(&w->mu);
+	while (w->queue_len > 0 || w->busy) {
+		pthread_cond_wait(&w->idle, &w->mu);
+	}
+	bool ok = w->err == 0;
+	pthread_mutex_unlock(&w->mu);
+	return ok;
+}
+
+#endif // SB_ASYNC_IMPLEMENTATION
+
+#endif // SB_ASYNC_H
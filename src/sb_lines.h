@@ -0,0 +1,163 @@
+#ifndef SB_LINES_H
+#define SB_LINES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sb.h"
+
+#ifndef SB_LINES_DEFAULT_CAP
+#define SB_LINES_DEFAULT_CAP (256 * 1024)
+#endif // SB_LINES_DEFAULT_CAP
+
+/**
+ * Buffered line reader. Input is read from a file descriptor into a string
+ * builder in large chunks, and lines are returned as slices of that buffer,
+ * so nothing is copied per line.
+ */
+typedef struct sb_lines {
+	string_builder buf; // The input buffer.
+	int fd;             // The file descriptor to read from.
+	size_t pos;         // The offset of the first unreturned byte in `buf`.
+	size_t scan;        // The offset to resume looking for a newline at.
+	size_t max_line;    // The longest line returned whole, or zero (0) for no limit.
+	bool partial;       // Whether the last line was cut at `max_line` bytes.
+	bool eof;           // Whether the end of the input has been read.
+	int err;            // The errno of the failed read, or zero (0).
+} sb_lines;
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Initializes a line reader.
+ * @param r        Line reader pointer.
+ * @param fd       The file descriptor to read from.
+ * @param cap      The initial size of the buffer, or zero (0) for `SB_LINES_DEFAULT_CAP`.
+ *                 The buffer grows to fit longer lines.
+ * @param max_line The longest line to return whole, or zero (0) for no limit.
+ *                 Longer lines are returned in pieces of `max_line` bytes with
+ *                 `partial` set on all but the last, so the buffer stays bounded.
+ */
+void sb_lines_init(sb_lines *r, int fd, size_t cap, size_t max_line);
+
+/**
+ * Deinitializes a line reader. The file descriptor is not closed.
+ * @param r Line reader pointer.
+ */
+void sb_lines_deinit(sb_lines *r);
+
+/**
+ * Reads the next line. The line does not include its newline, but does
+ * include a preceding carriage return. The last line of the input need not
+ * end with a newline.
+ * @param r    Line reader pointer.
+ * @param line Set to the line, which is valid until the next call.
+ * @return `true` if a line was read; otherwise, `false` at the end of the
+ *         input or on error, when `r->err` holds the error.
+ */
+bool sb_lines_next(sb_lines *r, sb_slice *line);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef SB_LINES_IMPLEMENTATION
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+void sb_lines_init(sb_lines *r, int fd, size_t cap, size_t max_line) {
+	// The buffer is overwritten by every read, so clearing it is wasted work.
+	sb_init_flags(&r->buf, cap > 0 ? cap : SB_LINES_DEFAULT_CAP, SB_NOZERO);
+	r->fd = fd;
+	r->pos = 0;
+	r->scan = 0;
+	r->max_line = max_line;
+	r->partial = false;
+	r->eof = false;
+	r->err = 0;
+}
+
+void sb_lines_deinit(sb_lines *r) {
+	sb_deinit(&r->buf);
+}
+
+// Moves the unreturned bytes to the front and reads more after them.
+static bool sb_lines_fill(sb_lines *r) {
+	string_builder *sb = &r->buf;
+	if (r->pos > 0) {
+		const size_t rest = sb->len - r->pos;
+		if (rest > 0) {
+			memmove(sb->buf, sb->buf + r->pos, rest);
+		}
+		sb->len = rest;
+		r->scan -= r->pos;
+		r->pos = 0;
+	}
+	// Grow only when a single line fills the whole buffer.
+	size_t room = sb->cap > sb->len + 1 ? sb->cap - sb->len - 1 : 0;
+	if (room <= sb->cap / 4) {
+		// Doubles the buffer.
+		if (sb_reserve(sb, sb->cap > sb->len ? sb->cap - sb->len : SB_LINES_DEFAULT_CAP) == NULL) {
+			r->err = ENOMEM;
+			return false;
+		}
+		room = sb->cap - sb->len - 1;
+	}
+	for (;;) {
+		const ssize_t n = read(r->fd, sb->buf + sb->len, room);
+		if (n < 0) {
+			if (errno == EINTR) { continue; }
+			r->err = errno;
+			return false;
+		}
+		if (n == 0) {
+			r->eof = true;
+			return false;
+		}
+		sb_advance(sb, (size_t)n);
+		return true;
+	}
+}
+
+bool sb_lines_next(sb_lines *r, sb_slice *line) {
+	string_builder *sb = &r->buf;
+	for (;;) {
+		// A line of `max_line` bytes may still be followed by its newline.
+		const bool capped = r->max_line > 0 && sb->len - r->pos > r->max_line;
+		const size_t limit = capped ? r->pos + r->max_line + 1 : sb->len;
+		// glibc's `memchr` scans a vector register at a time, and bytes
+		// already scanned before a refill are not scanned again.
+		const char *nl = r->scan < limit ? (const char *)memchr(sb->buf + r->scan, '\n', limit - r->scan) : NULL;
+		if (nl != NULL) {
+			const size_t end = (size_t)(nl - sb->buf);
+			*line = (sb_slice){ sb->buf + r->pos, end - r->pos };
+			r->pos = r->scan = end + 1;
+			r->partial = false;
+			return true;
+		}
+		if (capped) {
+			// The line is too long, so return what fits.
+			*line = (sb_slice){ sb->buf + r->pos, r->max_line };
+			r->pos = r->scan = r->pos + r->max_line;
+			r->partial = true;
+			return true;
+		}
+		r->scan = limit;
+		if (r->eof || r->err != 0 || !sb_lines_fill(r)) {
+			if (r->err != 0 || r->pos == sb->len) { return false; }
+			// The last line has no newline.
+			*line = (sb_slice){ sb->buf + r->pos, sb->len - r->pos };
+			r->pos = r->scan = sb->len;
+			r->partial = false;
+			return true;
+		}
+	}
+}
+
+#endif // SB_LINES_IMPLEMENTATION
+
+#endif // SB_LINES_H
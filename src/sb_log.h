@@ -0,0 +1,242 @@
+#ifndef SB_LOG_H
+#define SB_LOG_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "sb.h"
+
+/**
+ * Log levels.
+ */
+typedef enum sb_log_level {
+	SB_LOG_DEBUG,
+	SB_LOG_INFO,
+	SB_LOG_WARN,
+	SB_LOG_ERROR,
+} sb_log_level;
+
+// The longest thread tag, including its brackets and trailing space.
+#define SB_LOG_TAG_MAX 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Writes a log line prefix, e.g. `2026-10-18T09:41:07.123456Z INFO  [4242] `,
+ * with the current UTC time to the microsecond, the level padded to a fixed
+ * width and the calling thread's tag. The date and time are formatted once a
+ * second per thread, and only the microseconds are formatted per line.
+ * @param sb    String builder pointer.
+ * @param level The level.
+ * @return The number of bytes written.
+ */
+size_t sb_log_prefix(string_builder *sb, sb_log_level level);
+
+/**
+ * Writes a log line prefix with the given time.
+ * @param sb    String builder pointer.
+ * @param level The level.
+ * @param ts    The time, as from `clock_gettime(CLOCK_REALTIME, ...)`.
+ * @return The number of bytes written.
+ */
+size_t sb_log_prefix_at(string_builder *sb, sb_log_level level, const struct timespec *ts);
+
+/**
+ * Writes a log line: the prefix, the formatted message and a newline.
+ * @param sb     String builder pointer.
+ * @param level  The level.
+ * @param format The format string.
+ * @param ...    The arguments.
+ * @return The number of bytes written.
+ */
+size_t sb_logf(string_builder *sb, sb_log_level level, const char *format, ...);
+
+/**
+ * Writes a log line from a `stdarg` list.
+ * @param sb     String builder pointer.
+ * @param level  The level.
+ * @param format The format string.
+ * @param args   `stdarg` list.
+ * @return The number of bytes written.
+ */
+size_t sb_vlogf(string_builder *sb, sb_log_level level, const char *format, va_list args);
+
+/**
+ * Sets the calling thread's tag, e.g. `[worker-3] `. By default the tag is the
+ * thread ID on Linux with _GNU_SOURCE, and otherwise a number counting the
+ * threads that have logged.
+ * @param name The name. It is cut to fit `SB_LOG_TAG_MAX`.
+ * @param n    The number of bytes in `name`.
+ */
+void sb_log_set_thread(const char *name, size_t n);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef SB_LOG_IMPLEMENTATION
+
+#include <string.h>
+
+#if defined(__linux__) && defined(_GNU_SOURCE)
+#include <sys/syscall.h>
+#include <unistd.h>
+#define SB_LOG_GETTID
+#endif // __linux__ && _GNU_SOURCE
+
+#ifdef __cplusplus
+#define SB_LOG_TLS thread_local
+#else
+#define SB_LOG_TLS _Thread_local
+#endif // __cplusplus
+
+// `YYYY-MM-DDTHH:MM:SS.uuuuuuZ `
+#define SB_LOG_STAMP_LEN 28
+#define SB_LOG_USEC_AT 20
+#define SB_LOG_LEVEL_LEN 6
+
+static const char sb_log_levels[][SB_LOG_LEVEL_LEN + 1] = {
+	"DEBUG ",
+	"INFO  ",
+	"WARN  ",
+	"ERROR ",
+};
+
+static const char sb_log_digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// The calling thread's formatted second and tag.
+typedef struct sb_log_cache {
+	time_t sec;                  // The second `stamp` holds.
+	bool has_stamp;              // Whether `stamp` has been formatted.
+	char stamp[SB_LOG_STAMP_LEN];
+	char tag[SB_LOG_TAG_MAX];
+	size_t tag_len;              // The length of `tag`, or zero (0) until it is set.
+} sb_log_cache;
+
+static SB_LOG_TLS sb_log_cache sb_log_tls;
+#ifndef SB_LOG_GETTID
+static unsigned long sb_log_threads; // The number of threads that have been tagged.
+#endif // SB_LOG_GETTID
+
+static inline void sb_log_put2(char *p, const unsigned v) {
+	p[0] = sb_log_digit_pairs[v * 2];
+	p[1] = sb_log_digit_pairs[v * 2 + 1];
+}
+
+static void sb_log_format_second(sb_log_cache *cache, const time_t sec) {
+	struct tm tm;
+	char *p = cache->stamp;
+	if (gmtime_r(&sec, &tm) == NULL) {
+		memset(&tm, 0, sizeof(tm));
+	}
+	const unsigned year = (unsigned)(tm.tm_year + 1900) % 10000;
+	sb_log_put2(p, year / 100);
+	sb_log_put2(p + 2, year % 100);
+	p[4] = '-';
+	sb_log_put2(p + 5, (unsigned)tm.tm_mon + 1);
+	p[7] = '-';
+	sb_log_put2(p + 8, (unsigned)tm.tm_mday);
+	p[10] = 'T';
+	sb_log_put2(p + 11, (unsigned)tm.tm_hour);
+	p[13] = ':';
+	sb_log_put2(p + 14, (unsigned)tm.tm_min);
+	p[16] = ':';
+	// A leap second is 60.
+	sb_log_put2(p + 17, (unsigned)tm.tm_sec);
+	p[19] = '.';
+	p[26] = 'Z';
+	p[27] = ' ';
+	cache->sec = sec;
+	cache->has_stamp = true;
+}
+
+static void sb_log_default_tag(sb_log_cache *cache) {
+#ifdef SB_LOG_GETTID
+	unsigned long id = (unsigned long)syscall(SYS_gettid);
+#else
+	unsigned long id = __atomic_add_fetch(&sb_log_threads, 1, __ATOMIC_RELAXED);
+#endif // SB_LOG_GETTID
+	char digits[24];
+	char *end = digits + sizeof(digits);
+	char *p = end;
+	do {
+		*--p = (char)('0' + id % 10);
+		id /= 10;
+	} while (id > 0);
+	char *q = cache->tag;
+	*q++ = '[';
+	memcpy(q, p, (size_t)(end - p));
+	q += end - p;
+	*q++ = ']';
+	*q++ = ' ';
+	cache->tag_len = (size_t)(q - cache->tag);
+}
+
+void sb_log_set_thread(const char *name, size_t n) {
+	sb_log_cache *cache = &sb_log_tls;
+	if (n > SB_LOG_TAG_MAX - 3) {
+		n = SB_LOG_TAG_MAX - 3;
+	}
+	cache->tag[0] = '[';
+	memcpy(cache->tag + 1, name, n);
+	cache->tag[n + 1] = ']';
+	cache->tag[n + 2] = ' ';
+	cache->tag_len = n + 3;
+}
+
+size_t sb_log_prefix_at(string_builder *sb, sb_log_level level, const struct timespec *ts) {
+	sb_log_cache *cache = &sb_log_tls;
+	if (!cache->has_stamp || cache->sec != ts->tv_sec) {
+		sb_log_format_second(cache, ts->tv_sec);
+	}
+	if (cache->tag_len == 0) {
+		sb_log_default_tag(cache);
+	}
+	if ((unsigned)level > SB_LOG_ERROR) {
+		level = SB_LOG_ERROR;
+	}
+	const size_t n = SB_LOG_STAMP_LEN + SB_LOG_LEVEL_LEN + cache->tag_len;
+	char *p = sb_reserve(sb, n);
+	if (p == NULL) { return 0; }
+	memcpy(p, cache->stamp, SB_LOG_STAMP_LEN);
+	unsigned usec = (unsigned)(ts->tv_nsec / 1000);
+	char *u = p + SB_LOG_USEC_AT;
+	sb_log_put2(u, usec / 10000);
+	sb_log_put2(u + 2, usec / 100 % 100);
+	sb_log_put2(u + 4, usec % 100);
+	memcpy(p + SB_LOG_STAMP_LEN, sb_log_levels[level], SB_LOG_LEVEL_LEN);
+	memcpy(p + SB_LOG_STAMP_LEN + SB_LOG_LEVEL_LEN, cache->tag, cache->tag_len);
+	sb_advance(sb, n);
+	return n;
+}
+
+size_t sb_log_prefix(string_builder *sb, sb_log_level level) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return sb_log_prefix_at(sb, level, &ts);
+}
+
+size_t sb_vlogf(string_builder *sb, sb_log_level level, const char *format, va_list args) {
+	size_t n = sb_log_prefix(sb, level);
+	n += sb_vwritef(sb, format, args);
+	n += sb_writen(sb, "\n", 1);
+	return n;
+}
+
+size_t sb_logf(string_builder *sb, sb_log_level level, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	const size_t n = sb_vlogf(sb, level, format, args);
+	va_end(args);
+	return n;
+}
+
+#endif // SB_LOG_IMPLEMENTATION
+
+#endif // SB_LOG_H
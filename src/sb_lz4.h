@@ -0,0 +1,577 @@
+#ifndef SB_LZ4_H
+#define SB_LZ4_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sb.h"
+
+// The size of the uncompressed blocks of a frame. Flushing a builder of this
+// capacity lets whole blocks be compressed straight from its buffer.
+#define SB_LZ4_BLOCK (64 * 1024)
+
+/**
+ * Compressing sink flags.
+ */
+enum {
+	SB_LZ4_THREAD = 1 << 0,   // Compress and write blocks on a background thread.
+	SB_LZ4_CHECKSUM = 1 << 1, // End the frame with an XXH32 checksum of the content.
+};
+
+/**
+ * Streaming XXH32 state.
+ */
+typedef struct sb_lz4_xxh32 {
+	uint32_t v[4];     // The accumulators.
+	uint64_t total;    // The number of bytes hashed.
+	uint8_t mem[16];   // Bytes not yet consumed as a full stripe.
+	uint32_t mem_len;  // The number of bytes in `mem`.
+} sb_lz4_xxh32;
+
+/**
+ * Sink that compresses what a string builder flushes to it into an LZ4 frame
+ * and writes the frame to another sink. Blocks are compressed as they fill,
+ * so the uncompressed output is never held in memory. Pass `&z.sink` to
+ * `sb_init_sink`; the compressing sink must not be moved afterwards.
+ */
+typedef struct sb_lz4_sink {
+	sb_sink sink;           // The sink to flush string builders to.
+	sb_sink *out;           // The sink the frame is written to.
+	unsigned flags;         // `SB_LZ4_*` flags.
+	bool started;           // Whether the frame header has been written.
+
+	uint8_t *in;            // The block being filled.
+	size_t in_len;          // The number of bytes in `in`.
+	uint8_t *job;           // The block being compressed on the background thread.
+	size_t job_len;         // The number of bytes in `job`.
+	uint8_t *dst;           // The compressed block, with the frame header before the first.
+	uint32_t *table;        // The compressor's hash table.
+	sb_lz4_xxh32 xxh;       // The content checksum.
+
+	bool busy;              // Whether `job` holds a block.
+	bool stop;              // Whether the background thread should exit.
+	int err;                // The errno of the first failed write, or zero (0).
+	pthread_t thread;       // The background thread.
+	pthread_mutex_t mu;     // Guards the fields above.
+	pthread_cond_t work;    // Signaled when a block is submitted.
+	pthread_cond_t idle;    // Signaled when a block has been written.
+} sb_lz4_sink;
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Initializes a compressing sink.
+ * @param z     Compressing sink pointer.
+ * @param out   The sink to write the frame to. With `SB_LZ4_THREAD`, it is
+ *              written to from the background thread until `sb_lz4_finish`.
+ * @param flags `SB_LZ4_*` flags, or zero (0).
+ * @return `true` on success; otherwise, `false`.
+ */
+bool sb_lz4_init(sb_lz4_sink *z, sb_sink *out, unsigned flags);
+
+/**
+ * Compresses and writes the last block, then ends the frame. Flush the string
+ * builder first.
+ * @param z Compressing sink pointer.
+ * @return `true` if every write succeeded; otherwise, `false` and `z->sink.err`
+ *         holds the error.
+ */
+bool sb_lz4_finish(sb_lz4_sink *z);
+
+/**
+ * Deinitializes a compressing sink, stopping its background thread. Unless
+ * `sb_lz4_finish` was called, the frame is left unterminated.
+ * @param z Compressing sink pointer.
+ */
+void sb_lz4_deinit(sb_lz4_sink *z);
+
+/**
+ * Gets the most bytes that compressing `n` bytes into an LZ4 block takes.
+ * @param n The number of bytes to compress.
+ * @return The bound.
+ */
+size_t sb_lz4_bound(size_t n);
+
+/**
+ * Compresses bytes into a raw LZ4 block.
+ * @param src The bytes to compress.
+ * @param n   The number of bytes to compress.
+ * @param dst Where to write the block, with room for `sb_lz4_bound(n)` bytes.
+ * @return The size of the block.
+ */
+size_t sb_lz4_compress(const void *src, size_t n, void *dst);
+
+/**
+ * Resets an XXH32 state with a zero (0) seed, as used by LZ4 frames.
+ * @param h XXH32 state pointer.
+ */
+void sb_lz4_xxh32_reset(sb_lz4_xxh32 *h);
+
+/**
+ * Hashes bytes.
+ * @param h XXH32 state pointer.
+ * @param s The bytes.
+ * @param n The number of bytes.
+ */
+void sb_lz4_xxh32_update(sb_lz4_xxh32 *h, const void *s, size_t n);
+
+/**
+ * Gets the XXH32 digest of the bytes hashed so far.
+ * @param h XXH32 state pointer.
+ * @return The digest.
+ */
+uint32_t sb_lz4_xxh32_digest(const sb_lz4_xxh32 *h);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef SB_LZ4_IMPLEMENTATION
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SB_LZ4_HASH_LOG 12
+#define SB_LZ4_MIN_MATCH 4
+#define SB_LZ4_LAST_LITERALS 5 // A block ends with at least this many literals.
+#define SB_LZ4_MF_LIMIT 12     // The last match starts at least this far from the end.
+#define SB_LZ4_MAX_OFFSET 65535
+
+#define SB_LZ4_MAGIC 0x184D2204u
+// Version 01, independent blocks, no block checksums, no content size.
+#define SB_LZ4_FLG 0x60
+// Blocks of at most 64 KiB.
+#define SB_LZ4_BD 0x40
+#define SB_LZ4_HEADER 7
+#define SB_LZ4_UNCOMPRESSED 0x80000000u
+
+#define SB_LZ4_XXH_P1 0x9E3779B1u
+#define SB_LZ4_XXH_P2 0x85EBCA77u
+#define SB_LZ4_XXH_P3 0xC2B2AE3Du
+#define SB_LZ4_XXH_P4 0x27D4EB2Fu
+#define SB_LZ4_XXH_P5 0x165667B1u
+
+static inline uint32_t sb_lz4_read32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint32_t sb_lz4_read32le(const uint8_t *p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void sb_lz4_write32le(uint8_t *p, const uint32_t v) {
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t sb_lz4_rotl(const uint32_t x, const int r) {
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t sb_lz4_xxh_round(uint32_t acc, const uint32_t in) {
+	acc += in * SB_LZ4_XXH_P2;
+	return sb_lz4_rotl(acc, 13) * SB_LZ4_XXH_P1;
+}
+
+void sb_lz4_xxh32_reset(sb_lz4_xxh32 *h) {
+	h->v[0] = SB_LZ4_XXH_P1 + SB_LZ4_XXH_P2;
+	h->v[1] = SB_LZ4_XXH_P2;
+	h->v[2] = 0;
+	h->v[3] = 0 - SB_LZ4_XXH_P1;
+	h->total = 0;
+	h->mem_len = 0;
+}
+
+void sb_lz4_xxh32_update(sb_lz4_xxh32 *h, const void *s, size_t n) {
+	const uint8_t *p = (const uint8_t *)s;
+	const uint8_t *end = p + n;
+	h->total += n;
+	if (h->mem_len + n < 16) {
+		if (n > 0) {
+			memcpy(h->mem + h->mem_len, p, n);
+		}
+		h->mem_len += (uint32_t)n;
+		return;
+	}
+	if (h->mem_len > 0) {
+		const size_t fill = 16 - h->mem_len;
+		memcpy(h->mem + h->mem_len, p, fill);
+		for (int i = 0; i < 4; i++) {
+			h->v[i] = sb_lz4_xxh_round(h->v[i], sb_lz4_read32le(h->mem + 4 * i));
+		}
+		p += fill;
+		h->mem_len = 0;
+	}
+	uint32_t v0 = h->v[0], v1 = h->v[1], v2 = h->v[2], v3 = h->v[3];
+	for (; end - p >= 16; p += 16) {
+		v0 = sb_lz4_xxh_round(v0, sb_lz4_read32le(p));
+		v1 = sb_lz4_xxh_round(v1, sb_lz4_read32le(p + 4));
+		v2 = sb_lz4_xxh_round(v2, sb_lz4_read32le(p + 8));
+		v3 = sb_lz4_xxh_round(v3, sb_lz4_read32le(p + 12));
+	}
+	h->v[0] = v0;
+	h->v[1] = v1;
+	h->v[2] = v2;
+	h->v[3] = v3;
+	if (p < end) {
+		memcpy(h->mem, p, (size_t)(end - p));
+		h->mem_len = (uint32_t)(end - p);
+	}
+}
+
+uint32_t sb_lz4_xxh32_digest(const sb_lz4_xxh32 *h) {
+	uint32_t acc;
+	if (h->total >= 16) {
+		acc = sb_lz4_rotl(h->v[0], 1) + sb_lz4_rotl(h->v[1], 7) + sb_lz4_rotl(h->v[2], 12) + sb_lz4_rotl(h->v[3], 18);
+	} else {
+		acc = h->v[2] + SB_LZ4_XXH_P5;
+	}
+	acc += (uint32_t)h->total;
+	const uint8_t *p = h->mem;
+	const uint8_t *end = p + h->mem_len;
+	for (; end - p >= 4; p += 4) {
+		acc += sb_lz4_read32le(p) * SB_LZ4_XXH_P3;
+		acc = sb_lz4_rotl(acc, 17) * SB_LZ4_XXH_P4;
+	}
+	for (; p < end; p++) {
+		acc += *p * SB_LZ4_XXH_P5;
+		acc = sb_lz4_rotl(acc, 11) * SB_LZ4_XXH_P1;
+	}
+	acc ^= acc >> 15;
+	acc *= SB_LZ4_XXH_P2;
+	acc ^= acc >> 13;
+	acc *= SB_LZ4_XXH_P3;
+	acc ^= acc >> 16;
+	return acc;
+}
+
+size_t sb_lz4_bound(size_t n) {
+	return n + n / 255 + 16;
+}
+
+static inline uint32_t sb_lz4_hash(const uint32_t seq) {
+	return (seq * 2654435761u) >> (32 - SB_LZ4_HASH_LOG);
+}
+
+// The number of equal bytes at `a` and `b`, stopping at `limit`.
+static inline size_t sb_lz4_count(const uint8_t *a, const uint8_t *b, const uint8_t *limit) {
+	const uint8_t *start = a;
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	while (limit - a >= 8) {
+		uint64_t x, y;
+		memcpy(&x, a, 8);
+		memcpy(&y, b, 8);
+		if (x != y) {
+			return (size_t)(a - start) + (size_t)(__builtin_ctzll(x ^ y) >> 3);
+		}
+		a += 8;
+		b += 8;
+	}
+#endif // little endian
+	while (a < limit && *a == *b) {
+		a++;
+		b++;
+	}
+	return (size_t)(a - start);
+}
+
+static inline uint8_t *sb_lz4_put_len(uint8_t *op, size_t len) {
+	for (; len >= 255; len -= 255) {
+		*op++ = 255;
+	}
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+static uint8_t *sb_lz4_put_literals(uint8_t *op, uint8_t *token, const uint8_t *lit, size_t n) {
+	if (n >= 15) {
+		*token = 15 << 4;
+		op = sb_lz4_put_len(op, n - 15);
+	} else {
+		*token = (uint8_t)(n << 4);
+	}
+	memcpy(op, lit, n);
+	return op + n;
+}
+
+// Greedy single-probe matching, as in the reference `LZ4_compress_fast`.
+static size_t sb_lz4_compress_table(const uint8_t *src, size_t n, uint8_t *dst, uint32_t *table) {
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	const uint8_t *end = src + n;
+	uint8_t *op = dst;
+	if (n > SB_LZ4_MF_LIMIT) {
+		const uint8_t *mf_limit = end - SB_LZ4_MF_LIMIT;
+		const uint8_t *match_limit = end - SB_LZ4_LAST_LITERALS;
+		// Stale entries only cost a failed comparison.
+		memset(table, 0, sizeof(uint32_t) << SB_LZ4_HASH_LOG);
+		while (ip < mf_limit) {
+			const uint32_t seq = sb_lz4_read32(ip);
+			const uint32_t h = sb_lz4_hash(seq);
+			const uint8_t *ref = src + table[h];
+			table[h] = (uint32_t)(ip - src);
+			if (ref >= ip || ip - ref > SB_LZ4_MAX_OFFSET || sb_lz4_read32(ref) != seq) {
+				// Step further the longer nothing matches.
+				ip += 1 + ((size_t)(ip - anchor) >> 6);
+				continue;
+			}
+			while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+			const size_t len = SB_LZ4_MIN_MATCH
+				+ sb_lz4_count(ip + SB_LZ4_MIN_MATCH, ref + SB_LZ4_MIN_MATCH, match_limit);
+			uint8_t *token = op++;
+			op = sb_lz4_put_literals(op, token, anchor, (size_t)(ip - anchor));
+			const size_t offset = (size_t)(ip - ref);
+			*op++ = (uint8_t)offset;
+			*op++ = (uint8_t)(offset >> 8);
+			if (len - SB_LZ4_MIN_MATCH >= 15) {
+				*token |= 15;
+				op = sb_lz4_put_len(op, len - SB_LZ4_MIN_MATCH - 15);
+			} else {
+				*token |= (uint8_t)(len - SB_LZ4_MIN_MATCH);
+			}
+			ip += len;
+			anchor = ip;
+			if (ip < mf_limit) {
+				table[sb_lz4_hash(sb_lz4_read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+			}
+		}
+	}
+	uint8_t *token = op++;
+	op = sb_lz4_put_literals(op, token, anchor, (size_t)(end - anchor));
+	return (size_t)(op - dst);
+}
+
+size_t sb_lz4_compress(const void *src, size_t n, void *dst) {
+	uint32_t table[1 << SB_LZ4_HASH_LOG];
+	return sb_lz4_compress_table((const uint8_t *)src, n, (uint8_t *)dst, table);
+}
+
+// Writes the frame header, whose descriptor is checked with the second byte of its XXH32.
+static uint8_t *sb_lz4_header(sb_lz4_sink *z, uint8_t *op) {
+	sb_lz4_write32le(op, SB_LZ4_MAGIC);
+	op[4] = SB_LZ4_FLG | ((z->flags & SB_LZ4_CHECKSUM) ? 0x04 : 0);
+	op[5] = SB_LZ4_BD;
+	sb_lz4_xxh32 h;
+	sb_lz4_xxh32_reset(&h);
+	sb_lz4_xxh32_update(&h, op + 4, 2);
+	op[6] = (uint8_t)(sb_lz4_xxh32_digest(&h) >> 8);
+	z->started = true;
+	return op + SB_LZ4_HEADER;
+}
+
+// Compresses a block and writes it out, after the frame header if it is the
+// first. Runs on the background thread while there is one.
+static bool sb_lz4_emit(sb_lz4_sink *z, const uint8_t *src, size_t n) {
+	uint8_t *op = z->started ? z->dst : sb_lz4_header(z, z->dst);
+	if (z->flags & SB_LZ4_CHECKSUM) {
+		sb_lz4_xxh32_update(&z->xxh, src, n);
+	}
+	size_t size = sb_lz4_compress_table(src, n, op + 4, z->table);
+	if (size >= n) {
+		// Incompressible blocks are stored as they are.
+		memcpy(op + 4, src, n);
+		sb_lz4_write32le(op, (uint32_t)n | SB_LZ4_UNCOMPRESSED);
+		size = n;
+	} else {
+		sb_lz4_write32le(op, (uint32_t)size);
+	}
+	op += 4 + size;
+	return z->out->write(z->out, (const char *)z->dst, (size_t)(op - z->dst));
+}
+
+static void *sb_lz4_run(void *arg) {
+	sb_lz4_sink *z = (sb_lz4_sink *)arg;
+	pthread_mutex_lock(&z->mu);
+	for (;;) {
+		while (!z->busy && !z->stop) {
+			pthread_cond_wait(&z->work, &z->mu);
+		}
+		if (!z->busy) { break; }
+		const bool failed = z->err != 0;
+		pthread_mutex_unlock(&z->mu);
+
+		int err = 0;
+		if (!failed && !sb_lz4_emit(z, z->job, z->job_len)) {
+			err = z->out->err != 0 ? z->out->err : EIO;
+		}
+
+		pthread_mutex_lock(&z->mu);
+		if (err != 0 && z->err == 0) {
+			z->err = err;
+		}
+		z->busy = false;
+		pthread_cond_signal(&z->idle);
+	}
+	pthread_mutex_unlock(&z->mu);
+	return NULL;
+}
+
+// Hands the filled block to the background thread, or compresses it here.
+static bool sb_lz4_submit(sb_lz4_sink *z) {
+	if (!(z->flags & SB_LZ4_THREAD)) {
+		if (!sb_lz4_emit(z, z->in, z->in_len)) {
+			z->err = z->out->err != 0 ? z->out->err : EIO;
+		}
+		z->in_len = 0;
+		return z->err == 0;
+	}
+	pthread_mutex_lock(&z->mu);
+	while (z->busy) {
+		pthread_cond_wait(&z->idle, &z->mu);
+	}
+	// The previous block is done, so its buffer can be filled next.
+	uint8_t *spare = z->job;
+	z->job = z->in;
+	z->job_len = z->in_len;
+	z->in = spare;
+	z->in_len = 0;
+	z->busy = z->err == 0;
+	const bool ok = z->err == 0;
+	pthread_cond_signal(&z->work);
+	pthread_mutex_unlock(&z->mu);
+	return ok;
+}
+
+static bool sb_lz4_write(sb_sink *sink, const char *buf, size_t len) {
+	sb_lz4_sink *z = (sb_lz4_sink *)sink->ctx;
+	const uint8_t *p = (const uint8_t *)buf;
+	// The background thread reports errors when the next block is submitted.
+	if (!(z->flags & SB_LZ4_THREAD) && z->err != 0) {
+		sink->err = z->err;
+		return false;
+	}
+	bool ok = true;
+	while (len > 0 && ok) {
+		if (z->in_len == 0 && len >= SB_LZ4_BLOCK && !(z->flags & SB_LZ4_THREAD)) {
+			// Whole blocks are compressed from the builder's buffer without a copy.
+			if (!sb_lz4_emit(z, p, SB_LZ4_BLOCK)) {
+				z->err = z->out->err != 0 ? z->out->err : EIO;
+				ok = false;
+			}
+			p += SB_LZ4_BLOCK;
+			len -= SB_LZ4_BLOCK;
+			continue;
+		}
+		const size_t n = len < SB_LZ4_BLOCK - z->in_len ? len : SB_LZ4_BLOCK - z->in_len;
+		memcpy(z->in + z->in_len, p, n);
+		z->in_len += n;
+		p += n;
+		len -= n;
+		if (z->in_len == SB_LZ4_BLOCK) {
+			ok = sb_lz4_submit(z);
+		}
+	}
+	if (!ok) {
+		sink->err = z->err;
+	}
+	return ok;
+}
+
+bool sb_lz4_init(sb_lz4_sink *z, sb_sink *out, unsigned flags) {
+	memset(z, 0, sizeof(*z));
+	z->sink = sb_sink_callback(sb_lz4_write, z);
+	z->out = out;
+	z->flags = flags;
+	sb_lz4_xxh32_reset(&z->xxh);
+	z->in = (uint8_t *)malloc(SB_LZ4_BLOCK);
+	z->dst = (uint8_t *)malloc(SB_LZ4_HEADER + 4 + sb_lz4_bound(SB_LZ4_BLOCK));
+	z->table = (uint32_t *)malloc(sizeof(uint32_t) << SB_LZ4_HASH_LOG);
+	if (flags & SB_LZ4_THREAD) {
+		z->job = (uint8_t *)malloc(SB_LZ4_BLOCK);
+	}
+	if (z->in == NULL || z->dst == NULL || z->table == NULL || ((flags & SB_LZ4_THREAD) && z->job == NULL)) {
+		goto fail;
+	}
+	if (flags & SB_LZ4_THREAD) {
+		pthread_mutex_init(&z->mu, NULL);
+		pthread_cond_init(&z->work, NULL);
+		pthread_cond_init(&z->idle, NULL);
+		if (pthread_create(&z->thread, NULL, sb_lz4_run, z) != 0) {
+			pthread_mutex_destroy(&z->mu);
+			pthread_cond_destroy(&z->work);
+			pthread_cond_destroy(&z->idle);
+			goto fail;
+		}
+	}
+	return true;
+fail:
+	free(z->in);
+	free(z->job);
+	free(z->dst);
+	free(z->table);
+	z->in = NULL;
+	z->job = NULL;
+	z->dst = NULL;
+	z->table = NULL;
+	z->flags = 0;
+	return false;
+}
+
+// Stops the background thread once it has written the block it holds.
+static void sb_lz4_stop(sb_lz4_sink *z) {
+	if (!(z->flags & SB_LZ4_THREAD)) { return; }
+	pthread_mutex_lock(&z->mu);
+	z->stop = true;
+	pthread_cond_signal(&z->work);
+	pthread_mutex_unlock(&z->mu);
+	pthread_join(z->thread, NULL);
+	pthread_mutex_destroy(&z->mu);
+	pthread_cond_destroy(&z->work);
+	pthread_cond_destroy(&z->idle);
+	z->flags &= ~(unsigned)SB_LZ4_THREAD;
+}
+
+bool sb_lz4_finish(sb_lz4_sink *z) {
+	if (z->in == NULL) { return false; }
+	if (z->in_len > 0) {
+		sb_lz4_submit(z);
+	}
+	sb_lz4_stop(z);
+	if (z->err == 0) {
+		uint8_t tail[SB_LZ4_HEADER + 8];
+		uint8_t *op = tail;
+		if (!z->started) {
+			// The header normally goes out with the first block.
+			op = sb_lz4_header(z, op);
+		}
+		sb_lz4_write32le(op, 0);
+		op += 4;
+		if (z->flags & SB_LZ4_CHECKSUM) {
+			sb_lz4_write32le(op, sb_lz4_xxh32_digest(&z->xxh));
+			op += 4;
+		}
+		if (!z->out->write(z->out, (const char *)tail, (size_t)(op - tail))) {
+			z->err = z->out->err != 0 ? z->out->err : EIO;
+		}
+	}
+	z->sink.err = z->err;
+	return z->err == 0;
+}
+
+void sb_lz4_deinit(sb_lz4_sink *z) {
+	sb_lz4_stop(z);
+	free(z->in);
+	free(z->job);
+	free(z->dst);
+	free(z->table);
+	z->in = NULL;
+	z->job = NULL;
+	z->dst = NULL;
+	z->table = NULL;
+}
+
+#endif // SB_LZ4_IMPLEMENTATION
+
+#endif // SB_LZ4_H
@@ -0,0 +1,256 @@
+#ifndef SB_POOL_H
+#define SB_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sb.h"
+
+// The smallest and largest capacity classes, as powers of two.
+#ifndef SB_POOL_MIN_SHIFT
+#define SB_POOL_MIN_SHIFT 6
+#endif // SB_POOL_MIN_SHIFT
+#ifndef SB_POOL_MAX_SHIFT
+#define SB_POOL_MAX_SHIFT 26
+#endif // SB_POOL_MAX_SHIFT
+
+// The most buffers each thread keeps per capacity class.
+#ifndef SB_POOL_DEPTH
+#define SB_POOL_DEPTH 8
+#endif // SB_POOL_DEPTH
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Retention policy of the calling thread's pool.
+ */
+typedef struct sb_pool_policy {
+	size_t max_cap;         // Larger buffers are shrunk to this size, or freed.
+	size_t max_bytes;       // The most bytes of buffers the thread retains.
+	unsigned max_per_class; // The most buffers retained per class, at most `SB_POOL_DEPTH`.
+	bool shrink;            // Whether to shrink buffers over `max_cap` instead of freeing them.
+} sb_pool_policy;
+
+/**
+ * Initializes a string builder with a buffer of at least `cap` bytes from the
+ * calling thread's pool, or allocates one rounded up to a capacity class if
+ * the pool has none. A recycled buffer is already zeroed, so acquiring a warm
+ * builder neither allocates nor clears the whole buffer.
+ * @param sb    String builder pointer.
+ * @param cap   The minimum capacity.
+ * @param flags `SB_NOZERO` or zero (0).
+ */
+void sb_pool_acquire(string_builder *sb, size_t cap, unsigned flags);
+
+/**
+ * Deinitializes a string builder, returning its buffer to the calling
+ * thread's pool. Only the bytes that were used are zeroed. Buffers that are
+ * not from `malloc` (inline, mapped or from a custom allocator), or that the
+ * retention policy does not keep, are freed as with `sb_deinit`.
+ * @param sb String builder pointer.
+ */
+void sb_pool_release(string_builder *sb);
+
+/**
+ * Sets the retention policy of the calling thread's pool. Buffers already in
+ * the pool are kept until they are acquired or trimmed.
+ * @param policy The policy.
+ */
+void sb_pool_set_policy(const sb_pool_policy *policy);
+
+/**
+ * Frees every buffer in the calling thread's pool. The pool also frees its
+ * buffers when the thread exits.
+ */
+void sb_pool_trim(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef SB_POOL_IMPLEMENTATION
+
+#include <pthread.h>
+#include <string.h>
+
+#ifdef __cplusplus
+#define SB_POOL_TLS thread_local
+#else
+#define SB_POOL_TLS _Thread_local
+#endif // __cplusplus
+
+#define SB_POOL_CLASSES (SB_POOL_MAX_SHIFT - SB_POOL_MIN_SHIFT + 1)
+
+typedef struct sb_pool_entry {
+	char *buf;  // The buffer.
+	size_t cap; // The size of the buffer.
+	bool clean; // Whether the whole buffer is zero.
+} sb_pool_entry;
+
+// A thread's pool. Class `c` holds buffers of at least `1 << (c + SB_POOL_MIN_SHIFT)` bytes.
+typedef struct sb_pool_cache {
+	sb_pool_entry entries[SB_POOL_CLASSES][SB_POOL_DEPTH];
+	unsigned count[SB_POOL_CLASSES]; // The number of buffers in each class.
+	size_t bytes;                    // The total size of the buffers.
+	sb_pool_policy policy;           // The retention policy.
+} sb_pool_cache;
+
+static SB_POOL_TLS sb_pool_cache *sb_pool_tls;
+static pthread_once_t sb_pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t sb_pool_key;
+
+static void sb_pool_free_cache(sb_pool_cache *cache) {
+	for (int c = 0; c < SB_POOL_CLASSES; c++) {
+		for (unsigned i = 0; i < cache->count[c]; i++) {
+			free(cache->entries[c][i].buf);
+		}
+		cache->count[c] = 0;
+	}
+	cache->bytes = 0;
+}
+
+static void sb_pool_destroy(void *p) {
+	sb_pool_free_cache((sb_pool_cache *)p);
+	// Destructors of other keys may still release buffers on this thread, which
+	// then makes a new pool that pthread destroys in turn.
+	sb_pool_tls = NULL;
+	free(p);
+}
+
+static void sb_pool_make_key(void) {
+	pthread_key_create(&sb_pool_key, sb_pool_destroy);
+}
+
+// Gets the calling thread's pool, creating it on first use.
+static sb_pool_cache *sb_pool_get(void) {
+	if (sb_pool_tls != NULL) { return sb_pool_tls; }
+	sb_pool_cache *cache = (sb_pool_cache *)calloc(1, sizeof(sb_pool_cache));
+	if (cache == NULL) { return NULL; }
+	cache->policy.max_cap = (size_t)1 << 20;
+	cache->policy.max_bytes = (size_t)8 << 20;
+	cache->policy.max_per_class = SB_POOL_DEPTH;
+	cache->policy.shrink = true;
+	// The key's destructor frees the pool when the thread exits.
+	pthread_once(&sb_pool_once, sb_pool_make_key);
+	if (pthread_setspecific(sb_pool_key, cache) != 0) {
+		free(cache);
+		return NULL;
+	}
+	sb_pool_tls = cache;
+	return cache;
+}
+
+// The smallest class whose buffers all fit `cap` bytes, or -1 if none does.
+static int sb_pool_class_up(const size_t cap) {
+	int shift = SB_POOL_MIN_SHIFT;
+	while (shift <= SB_POOL_MAX_SHIFT && ((size_t)1 << shift) < cap) {
+		shift++;
+	}
+	return shift <= SB_POOL_MAX_SHIFT ? shift - SB_POOL_MIN_SHIFT : -1;
+}
+
+// The largest class that a buffer of `cap` bytes belongs to, or -1 if none.
+static int sb_pool_class_down(const size_t cap) {
+	if (cap < ((size_t)1 << SB_POOL_MIN_SHIFT)) { return -1; }
+	int shift = SB_POOL_MIN_SHIFT;
+	while (shift < SB_POOL_MAX_SHIFT && ((size_t)1 << (shift + 1)) <= cap) {
+		shift++;
+	}
+	return shift - SB_POOL_MIN_SHIFT;
+}
+
+void sb_pool_acquire(string_builder *sb, size_t cap, unsigned flags) {
+	flags &= SB_NOZERO;
+	const int want = sb_pool_class_up(cap > 0 ? cap : 1);
+	sb_pool_cache *cache = want >= 0 ? sb_pool_tls : NULL;
+	if (cache != NULL) {
+		// A buffer one class up is still a better deal than `malloc`.
+		for (int c = want; c <= want + 1 && c < SB_POOL_CLASSES; c++) {
+			if (cache->count[c] == 0) { continue; }
+			const sb_pool_entry e = cache->entries[c][--cache->count[c]];
+			cache->bytes -= e.cap;
+			if (!e.clean && !(flags & SB_NOZERO)) {
+				memset(e.buf, 0, e.cap);
+			}
+			e.buf[0] = 0;
+			sb->buf = e.buf;
+			sb->cap = e.cap;
+			sb->len = 0;
+			sb->flags = flags;
+			sb->flushes = 0;
+			sb->sink = NULL;
+			sb->alloc = NULL;
+			sb->alloc_ctx = NULL;
+			sb->hash = NULL;
+#ifdef SB_STATS
+			memset(&sb->stats, 0, sizeof(sb->stats));
+#endif // SB_STATS
+			return;
+		}
+	}
+	// Round up to the class so the buffer can be recycled at this size.
+	sb_init_flags(sb, want >= 0 ? (size_t)1 << (want + SB_POOL_MIN_SHIFT) : cap, flags);
+}
+
+void sb_pool_release(string_builder *sb) {
+	if (sb == NULL) { return; }
+	if (sb->buf == NULL || (sb->flags & (SB_INLINE | SB_MMAP)) || sb->alloc != NULL) {
+		sb_deinit(sb);
+		return;
+	}
+#ifdef SB_STATS
+	sb_stats_retire(sb);
+#endif // SB_STATS
+	sb_pool_cache *cache = sb_pool_get();
+	const sb_pool_policy *policy = cache != NULL ? &cache->policy : NULL;
+	char *buf = sb->buf;
+	size_t cap = sb->cap;
+	const bool clean = !(sb->flags & SB_NOZERO);
+	// Past `len`, a zeroing builder's buffer is still zero.
+	const size_t used = sb->len + 1 < cap ? sb->len + 1 : cap;
+	sb->buf = NULL;
+	sb->cap = 0;
+	sb->len = 0;
+	sb->flags = 0;
+	if (policy != NULL && cap > policy->max_cap && policy->shrink && policy->max_cap > 0) {
+		char *shrunk = (char *)realloc(buf, policy->max_cap);
+		if (shrunk != NULL) {
+			buf = shrunk;
+			cap = policy->max_cap;
+		}
+	}
+	const int c = sb_pool_class_down(cap);
+	if (policy == NULL || c < 0 || cap > policy->max_cap
+		|| cache->count[c] >= policy->max_per_class || cache->count[c] >= SB_POOL_DEPTH
+		|| cache->bytes + cap > policy->max_bytes) {
+		free(buf);
+		return;
+	}
+	if (clean) {
+		memset(buf, 0, used < cap ? used : cap);
+	}
+	sb_pool_entry *e = &cache->entries[c][cache->count[c]++];
+	e->buf = buf;
+	e->cap = cap;
+	e->clean = clean;
+	cache->bytes += cap;
+}
+
+void sb_pool_set_policy(const sb_pool_policy *policy) {
+	sb_pool_cache *cache = sb_pool_get();
+	if (cache != NULL) {
+		cache->policy = *policy;
+	}
+}
+
+void sb_pool_trim(void) {
+	if (sb_pool_tls != NULL) {
+		sb_pool_free_cache(sb_pool_tls);
+	}
+}
+
+#endif // SB_POOL_IMPLEMENTATION
+
+#endif // SB_POOL_H
@@ -0,0 +1,343 @@
+#ifndef SB_SHARED_H
+#define SB_SHARED_H
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "sb.h"
+
+#ifndef SB_SHARED_DEFAULT_MAX
+#define SB_SHARED_DEFAULT_MAX ((size_t)1 << 34)
+#endif // SB_SHARED_DEFAULT_MAX
+
+#ifndef SB_SHARED_BLOCK
+#define SB_SHARED_BLOCK 4096
+#endif // SB_SHARED_BLOCK
+
+/**
+ * Concurrent string builder. Writers reserve byte ranges with an atomic
+ * compare-and-swap, fill them in parallel and then commit them without waiting for
+ * each other. The buffer is a pre-reserved virtual region that is backed by
+ * memory as it is touched, so reservations never move. A single flusher
+ * drains the committed prefix.
+ *
+ * Commits are counted per `SB_SHARED_BLOCK` bytes, so the prefix advances a
+ * block at a time while writers are active, and up to the last reserved byte
+ * whenever every reservation has been committed.
+ */
+typedef struct sb_shared {
+	char *buf;                  // The reserved virtual region.
+	size_t cap;                 // The size of the region.
+	_Atomic uint32_t *blocks;   // The number of committed bytes per block.
+	size_t nblocks;             // The number of blocks.
+	_Atomic size_t reserved;    // The number of bytes handed out to writers.
+	_Atomic size_t done;        // The number of bytes committed by writers.
+	size_t committed;           // The known committed prefix. Flusher-only.
+	size_t flushed;             // The number of bytes drained. Flusher-only.
+} sb_shared;
+
+/**
+ * Initializes a concurrent string builder. Only address space is reserved up
+ * front; memory is committed page by page as writers touch it and released
+ * again as the flusher drains it.
+ * @param s   Concurrent string builder pointer.
+ * @param max The size of the virtual region, which bounds the total number of
+ *            bytes written until `sb_shared_reset`. Zero (0) selects
+ *            `SB_SHARED_DEFAULT_MAX`.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool sb_shared_init(sb_shared *s, size_t max);
+
+/**
+ * Deinitializes a concurrent string builder and unmaps its region.
+ * @param s Concurrent string builder pointer.
+ */
+void sb_shared_deinit(sb_shared *s);
+
+/**
+ * Reserves `n` bytes for the calling writer. Every successful reservation
+ * must be committed with `sb_shared_commit`, or the prefix stops advancing.
+ * @param s   Concurrent string builder pointer.
+ * @param n   The number of bytes to reserve.
+ * @param off Receives the offset of the reservation.
+ * @return A pointer to the reserved bytes, or `NULL` if the region is full.
+ */
+char *sb_shared_reserve(sb_shared *s, size_t n, size_t *off);
+
+/**
+ * Publishes a filled reservation. Never waits for other writers.
+ * @param s   Concurrent string builder pointer.
+ * @param off The offset returned by `sb_shared_reserve`.
+ * @param n   The number of bytes reserved.
+ */
+void sb_shared_commit(sb_shared *s, size_t off, size_t n);
+
+/**
+ * Writes `n` bytes as a single contiguous record.
+ * @param s   Concurrent string builder pointer.
+ * @param str Bytes to write.
+ * @param n   The number of bytes to write.
+ * @return The number of bytes written.
+ */
+size_t sb_shared_write(sb_shared *s, const char *str, size_t n);
+
+/**
+ * Writes a formatted string as a single contiguous record.
+ * @param s      Concurrent string builder pointer.
+ * @param format The format string.
+ * @param ...    The arguments.
+ * @return The number of bytes written.
+ */
+size_t sb_shared_writef(sb_shared *s, const char *format, ...);
+
+/**
+ * Writes a formatted string from a `stdarg` list as a single contiguous record.
+ * @param s      Concurrent string builder pointer.
+ * @param format The format string.
+ * @param args   `stdarg` list.
+ * @return The number of bytes written.
+ */
+size_t sb_shared_vwritef(sb_shared *s, const char *format, va_list args);
+
+/**
+ * Gets the committed bytes that have not been drained yet. Flusher-only.
+ * @param s Concurrent string builder pointer.
+ * @return The pending committed bytes.
+ */
+sb_slice sb_shared_pending(sb_shared *s);
+
+/**
+ * Marks `n` pending bytes as drained and releases the memory of fully drained
+ * pages. Flusher-only.
+ * @param s Concurrent string builder pointer.
+ * @param n The number of bytes drained. Must not exceed the pending bytes.
+ */
+void sb_shared_consume(sb_shared *s, size_t n);
+
+/**
+ * Writes the committed prefix that has not been drained yet to a file
+ * descriptor. Flusher-only.
+ * @param s  Concurrent string builder pointer.
+ * @param fd The file descriptor to write to.
+ * @return The number of bytes written, or `-1` on error with errno set.
+ */
+ssize_t sb_shared_drain(sb_shared *s, int fd);
+
+/**
+ * Rewinds the region to the start so it can be written again. Only valid when
+ * no writer is active and everything has been drained.
+ * @param s Concurrent string builder pointer.
+ */
+void sb_shared_reset(sb_shared *s);
+
+#ifdef SB_SHARED_IMPLEMENTATION
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif // !MAP_ANONYMOUS && MAP_ANON
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif // MAP_NORESERVE
+
+static void *sb_shared_map(const size_t size) {
+#ifndef MAP_ANONYMOUS
+	(void)size;
+	return NULL;
+#else
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return p != MAP_FAILED ? p : NULL;
+#endif // MAP_ANONYMOUS
+}
+
+// Releases the memory behind whole pages, which read back as zero afterwards.
+static bool sb_shared_release(void *p, const size_t size) {
+#ifdef MADV_DONTNEED
+	return madvise(p, size, MADV_DONTNEED) == 0;
+#else
+	(void)p;
+	(void)size;
+	return false;
+#endif // MADV_DONTNEED
+}
+
+bool sb_shared_init(sb_shared *s, size_t max) {
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	max = max > 0 ? max : SB_SHARED_DEFAULT_MAX;
+	max = (max + SB_SHARED_BLOCK - 1) & ~((size_t)SB_SHARED_BLOCK - 1);
+	max = (max + page - 1) & ~(page - 1);
+	s->nblocks = max / SB_SHARED_BLOCK;
+	s->buf = (char *)sb_shared_map(max);
+	// Fresh anonymous pages are zero, which is a valid atomic zero here.
+	s->blocks = (_Atomic uint32_t *)sb_shared_map(s->nblocks * sizeof(*s->blocks));
+	if (s->buf == NULL || s->blocks == NULL) {
+		if (s->buf != NULL) { munmap(s->buf, max); }
+		if (s->blocks != NULL) { munmap((void *)s->blocks, s->nblocks * sizeof(*s->blocks)); }
+		s->buf = NULL;
+		s->blocks = NULL;
+		s->cap = 0;
+		return false;
+	}
+	s->cap = max;
+	atomic_init(&s->reserved, 0);
+	atomic_init(&s->done, 0);
+	s->committed = 0;
+	s->flushed = 0;
+	return true;
+}
+
+void sb_shared_deinit(sb_shared *s) {
+	if (s == NULL || s->buf == NULL) { return; }
+	munmap(s->buf, s->cap);
+	munmap((void *)s->blocks, s->nblocks * sizeof(*s->blocks));
+	s->buf = NULL;
+	s->blocks = NULL;
+	s->cap = 0;
+}
+
+char *sb_shared_reserve(sb_shared *s, size_t n, size_t *off) {
+	// A failed reservation must not move `reserved`, or it would never equal
+	// `done` again and the bytes committed after the last full block would be
+	// stuck, so claim the range only if it fits.
+	size_t start = atomic_load_explicit(&s->reserved, memory_order_relaxed);
+	do {
+		if (n > s->cap - start) {
+			return NULL;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&s->reserved, &start, start + n, memory_order_relaxed, memory_order_relaxed));
+	*off = start;
+	return s->buf + start;
+}
+
+void sb_shared_commit(sb_shared *s, size_t off, size_t n) {
+	const size_t end = off + n;
+	while (off < end) {
+		const size_t block_end = (off / SB_SHARED_BLOCK + 1) * SB_SHARED_BLOCK;
+		const size_t m = (end < block_end ? end : block_end) - off;
+		atomic_fetch_add_explicit(&s->blocks[off / SB_SHARED_BLOCK], (uint32_t)m, memory_order_release);
+		off += m;
+	}
+	atomic_fetch_add_explicit(&s->done, n, memory_order_release);
+}
+
+size_t sb_shared_write(sb_shared *s, const char *str, size_t n) {
+	size_t off;
+	char *dst = sb_shared_reserve(s, n, &off);
+	if (dst == NULL) {
+		return 0;
+	}
+	memcpy(dst, str, n);
+	sb_shared_commit(s, off, n);
+	return n;
+}
+
+size_t sb_shared_writef(sb_shared *s, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	const size_t n = sb_shared_vwritef(s, format, args);
+	va_end(args);
+	return n;
+}
+
+size_t sb_shared_vwritef(sb_shared *s, const char *format, va_list args) {
+	// vsnprintf always writes a terminator, which would land in the next
+	// writer's range, so format into a local buffer and copy.
+	char local[512];
+	va_list args_copy;
+	va_copy(args_copy, args);
+	const int len = vsnprintf(local, sizeof(local), format, args_copy);
+	va_end(args_copy);
+	if (len < 0) {
+		return 0;
+	}
+	if ((size_t)len < sizeof(local)) {
+		return sb_shared_write(s, local, len);
+	}
+	char *tmp = (char *)malloc((size_t)len + 1);
+	if (tmp == NULL) {
+		return 0;
+	}
+	vsnprintf(tmp, (size_t)len + 1, format, args);
+	const size_t n = sb_shared_write(s, tmp, len);
+	free(tmp);
+	return n;
+}
+
+sb_slice sb_shared_pending(sb_shared *s) {
+	// Every block that is completely committed extends the prefix.
+	size_t end = s->committed;
+	while (end < s->cap) {
+		const size_t b = end / SB_SHARED_BLOCK;
+		if (atomic_load_explicit(&s->blocks[b], memory_order_acquire) != SB_SHARED_BLOCK) {
+			break;
+		}
+		end = (b + 1) * SB_SHARED_BLOCK;
+	}
+	// If all reservations are committed, the prefix is everything reserved.
+	// `done` is read first: it only counts reservations that `reserved` then
+	// includes, so equal totals mean none is outstanding.
+	const size_t done = atomic_load_explicit(&s->done, memory_order_acquire);
+	const size_t reserved = atomic_load_explicit(&s->reserved, memory_order_relaxed);
+	if (done == reserved && reserved > end) {
+		end = reserved;
+	}
+	s->committed = end;
+	sb_slice pending = { s->buf + s->flushed, end - s->flushed };
+	return pending;
+}
+
+void sb_shared_consume(sb_shared *s, size_t n) {
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t from = s->flushed & ~(page - 1);
+	s->flushed += n;
+	const size_t to = s->flushed & ~(page - 1);
+	if (to > from) {
+		sb_shared_release(s->buf + from, to - from);
+	}
+}
+
+ssize_t sb_shared_drain(sb_shared *s, int fd) {
+	sb_slice pending = sb_shared_pending(s);
+	size_t total = 0;
+	while (total < pending.len) {
+		ssize_t n = write(fd, pending.ptr + total, pending.len - total);
+		if (n < 0) {
+			if (errno == EINTR) { continue; }
+			sb_shared_consume(s, total);
+			return -1;
+		}
+		total += (size_t)n;
+	}
+	sb_shared_consume(s, total);
+	return (ssize_t)total;
+}
+
+void sb_shared_reset(sb_shared *s) {
+	// Dropping the pages of the private mappings zeroes them.
+	sb_shared_release(s->buf, s->cap);
+	if (!sb_shared_release((void *)s->blocks, s->nblocks * sizeof(*s->blocks))) {
+		// Only the blocks up to the last reservation were counted.
+		const size_t used = atomic_load(&s->reserved);
+		for (size_t b = 0; b * SB_SHARED_BLOCK < used; b++) {
+			atomic_init(&s->blocks[b], 0);
+		}
+	}
+	atomic_store(&s->reserved, 0);
+	atomic_store(&s->done, 0);
+	s->committed = 0;
+	s->flushed = 0;
+}
+
+#endif // SB_SHARED_IMPLEMENTATION
+
+#endif // SB_SHARED_H
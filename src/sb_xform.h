@@ -0,0 +1,392 @@
+#ifndef SB_XFORM_H
+#define SB_XFORM_H
+
+#include <stddef.h>
+
+#include "sb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Converts ASCII letters in the string builder's contents to lower case.
+ * Other bytes, including UTF-8 sequences, are left as they are.
+ * @param sb String builder pointer.
+ */
+void sb_to_lower(string_builder *sb);
+
+/**
+ * Converts ASCII letters in the string builder's contents to upper case.
+ * @param sb String builder pointer.
+ */
+void sb_to_upper(string_builder *sb);
+
+/**
+ * Removes leading and trailing ASCII whitespace (" \t\n\v\f\r").
+ * @param sb String builder pointer.
+ * @return The number of bytes removed.
+ */
+size_t sb_trim(string_builder *sb);
+
+/**
+ * Replaces each byte that occurs in `from` with the byte at the same index in
+ * `to`, like `tr`. If a byte occurs more than once in `from`, the last
+ * occurrence wins.
+ * @param sb   String builder pointer.
+ * @param from The bytes to replace.
+ * @param to   The replacement bytes.
+ * @param n    The number of bytes in `from` and `to`.
+ */
+void sb_translate(string_builder *sb, const char *from, const char *to, size_t n);
+
+/**
+ * Removes ASCII control characters (0x00-0x1F and 0x7F).
+ * @param sb String builder pointer.
+ * @return The number of bytes removed.
+ */
+size_t sb_strip_ctrl(string_builder *sb);
+
+/**
+ * Replaces each run of ASCII whitespace with a single space.
+ * @param sb String builder pointer.
+ * @return The number of bytes removed.
+ */
+size_t sb_collapse_space(string_builder *sb);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef SB_XFORM_IMPLEMENTATION
+
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SB_XFORM_X86
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif // x86 && (GCC || Clang)
+
+// Mappings with more pairs than this go through a lookup table instead.
+#ifndef SB_XFORM_TR_SIMD_MAX
+#define SB_XFORM_TR_SIMD_MAX 8
+#endif // SB_XFORM_TR_SIMD_MAX
+
+static inline bool sb_xform_is_space(const unsigned char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool sb_xform_is_ctrl(const unsigned char c) {
+	return c < 0x20 || c == 0x7F;
+}
+
+// Sets the new length after bytes were removed, keeping the zeroed tail.
+static void sb_xform_truncate(string_builder *sb, const size_t len) {
+	if (!(sb->flags & SB_NOZERO)) {
+		memset(sb->buf + len, 0, sb->len - len);
+	}
+	sb->len = len;
+	sb->buf[len] = 0;
+	sb_hash_sync(sb);
+}
+
+// Appends the bytes of `src` whose bit in `drop` is clear to `dst`.
+static size_t sb_xform_pack(char *dst, const char *src, const int n, const uint32_t drop) {
+	size_t o = 0;
+	for (int k = 0; k < n; k++) {
+		dst[o] = src[k];
+		o += !((drop >> k) & 1);
+	}
+	return o;
+}
+
+#ifdef SB_XFORM_X86
+static bool sb_xform_avx2(void) {
+	return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sb_xform_range_avx2(const __m256i v, const char lo, const char hi) {
+	return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((char)(lo - 1))),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8((char)(hi + 1)), v));
+}
+
+__attribute__((target("avx2")))
+static size_t sb_xform_case_avx2(char *b, const size_t n, const char lo, const char hi) {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(b + i));
+		const __m256i flip = _mm256_and_si256(sb_xform_range_avx2(v, lo, hi), _mm256_set1_epi8(0x20));
+		_mm256_storeu_si256((__m256i *)(b + i), _mm256_xor_si256(v, flip));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t sb_xform_translate_avx2(char *b, const size_t n, const char *from, const char *to, const size_t k) {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i r = v;
+		for (size_t j = 0; j < k; j++) {
+			const __m256i eq = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(from[j]));
+			r = _mm256_blendv_epi8(r, _mm256_set1_epi8(to[j]), eq);
+		}
+		_mm256_storeu_si256((__m256i *)(b + i), r);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sb_xform_space_avx2(const __m256i v) {
+	return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), sb_xform_range_avx2(v, '\t', '\r'));
+}
+
+// Blocks without control characters are moved as a whole.
+__attribute__((target("avx2")))
+static size_t sb_xform_strip_ctrl_avx2(char *b, const size_t n, size_t *out) {
+	size_t i = 0;
+	size_t o = 0;
+	for (; i + 32 <= n; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(b + i));
+		const __m256i ctrl = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+		const uint32_t drop = (uint32_t)_mm256_movemask_epi8(ctrl);
+		if (drop == 0) {
+			_mm256_storeu_si256((__m256i *)(b + o), v);
+			o += 32;
+		} else {
+			char tmp[32];
+			_mm256_storeu_si256((__m256i *)tmp, v);
+			o += sb_xform_pack(b + o, tmp, 32, drop);
+		}
+	}
+	*out = o;
+	return i;
+}
+
+// `prev` carries whether the byte before the block was whitespace.
+__attribute__((target("avx2")))
+static size_t sb_xform_collapse_avx2(char *b, const size_t n, size_t *out, bool *prev) {
+	size_t i = 0;
+	size_t o = 0;
+	for (; i + 32 <= n; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(b + i));
+		const __m256i sp = sb_xform_space_avx2(v);
+		const uint32_t ws = (uint32_t)_mm256_movemask_epi8(sp);
+		const uint32_t drop = ws & (ws << 1 | (uint32_t)*prev);
+		*prev = ws >> 31;
+		const __m256i r = _mm256_blendv_epi8(v, _mm256_set1_epi8(' '), sp);
+		if (drop == 0) {
+			_mm256_storeu_si256((__m256i *)(b + o), r);
+			o += 32;
+		} else {
+			char tmp[32];
+			_mm256_storeu_si256((__m256i *)tmp, r);
+			o += sb_xform_pack(b + o, tmp, 32, drop);
+		}
+	}
+	*out = o;
+	return i;
+}
+#endif // SB_XFORM_X86
+
+#ifdef __SSE2__
+static inline __m128i sb_xform_range_sse2(const __m128i v, const char lo, const char hi) {
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+		_mm_cmpgt_epi8(_mm_set1_epi8((char)(hi + 1)), v));
+}
+
+static inline __m128i sb_xform_space_sse2(const __m128i v) {
+	return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), sb_xform_range_sse2(v, '\t', '\r'));
+}
+#endif // __SSE2__
+
+// Flips the case of the bytes in [lo, hi].
+static void sb_xform_case(string_builder *sb, const char lo, const char hi) {
+	if (sb == NULL || sb->buf == NULL) { return; }
+	char *b = sb->buf;
+	const size_t n = sb->len;
+	size_t i = 0;
+#ifdef SB_XFORM_X86
+	if (sb_xform_avx2()) {
+		i = sb_xform_case_avx2(b, n, lo, hi);
+	}
+#endif // SB_XFORM_X86
+#ifdef __SSE2__
+	for (; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(b + i));
+		const __m128i flip = _mm_and_si128(sb_xform_range_sse2(v, lo, hi), _mm_set1_epi8(0x20));
+		_mm_storeu_si128((__m128i *)(b + i), _mm_xor_si128(v, flip));
+	}
+#endif // __SSE2__
+	for (; i < n; i++) {
+		if (b[i] >= lo && b[i] <= hi) {
+			b[i] ^= 0x20;
+		}
+	}
+	sb_hash_sync(sb);
+}
+
+void sb_to_lower(string_builder *sb) {
+	sb_xform_case(sb, 'A', 'Z');
+}
+
+void sb_to_upper(string_builder *sb) {
+	sb_xform_case(sb, 'a', 'z');
+}
+
+size_t sb_trim(string_builder *sb) {
+	if (sb == NULL || sb->buf == NULL) { return 0; }
+	const char *b = sb->buf;
+	size_t start = 0;
+	size_t end = sb->len;
+#ifdef __SSE2__
+	while (start + 16 <= end && _mm_movemask_epi8(sb_xform_space_sse2(_mm_loadu_si128((const __m128i *)(b + start)))) == 0xFFFF) {
+		start += 16;
+	}
+#endif // __SSE2__
+	while (start < end && sb_xform_is_space((unsigned char)b[start])) {
+		start++;
+	}
+	while (end > start && sb_xform_is_space((unsigned char)b[end-1])) {
+		end--;
+	}
+	const size_t removed = sb->len - (end - start);
+	if (removed > 0) {
+		memmove(sb->buf, b + start, end - start);
+		sb_xform_truncate(sb, end - start);
+	}
+	return removed;
+}
+
+void sb_translate(string_builder *sb, const char *from, const char *to, size_t n) {
+	if (sb == NULL || sb->buf == NULL || n == 0) { return; }
+	char *b = sb->buf;
+	const size_t len = sb->len;
+	size_t i = 0;
+	if (n > SB_XFORM_TR_SIMD_MAX) {
+		unsigned char table[256];
+		for (int c = 0; c < 256; c++) {
+			table[c] = (unsigned char)c;
+		}
+		for (size_t j = 0; j < n; j++) {
+			table[(unsigned char)from[j]] = (unsigned char)to[j];
+		}
+		for (; i < len; i++) {
+			b[i] = (char)table[(unsigned char)b[i]];
+		}
+		sb_hash_sync(sb);
+		return;
+	}
+#ifdef SB_XFORM_X86
+	if (sb_xform_avx2()) {
+		i = sb_xform_translate_avx2(b, len, from, to, n);
+	}
+#endif // SB_XFORM_X86
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i r = v;
+		for (size_t j = 0; j < n; j++) {
+			const __m128i eq = _mm_cmpeq_epi8(v, _mm_set1_epi8(from[j]));
+			r = _mm_or_si128(_mm_and_si128(eq, _mm_set1_epi8(to[j])), _mm_andnot_si128(eq, r));
+		}
+		_mm_storeu_si128((__m128i *)(b + i), r);
+	}
+#endif // __SSE2__
+	for (; i < len; i++) {
+		for (size_t j = n; j-- > 0;) {
+			if (b[i] == from[j]) {
+				b[i] = to[j];
+				break;
+			}
+		}
+	}
+	sb_hash_sync(sb);
+}
+
+size_t sb_strip_ctrl(string_builder *sb) {
+	if (sb == NULL || sb->buf == NULL) { return 0; }
+	char *b = sb->buf;
+	const size_t n = sb->len;
+	size_t i = 0;
+	size_t o = 0;
+#ifdef SB_XFORM_X86
+	if (sb_xform_avx2()) {
+		i = sb_xform_strip_ctrl_avx2(b, n, &o);
+	}
+#endif // SB_XFORM_X86
+#ifdef __SSE2__
+	for (; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(b + i));
+		const __m128i ctrl = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+		const uint32_t drop = (uint32_t)_mm_movemask_epi8(ctrl);
+		if (drop == 0) {
+			_mm_storeu_si128((__m128i *)(b + o), v);
+			o += 16;
+		} else {
+			char tmp[16];
+			_mm_storeu_si128((__m128i *)tmp, v);
+			o += sb_xform_pack(b + o, tmp, 16, drop);
+		}
+	}
+#endif // __SSE2__
+	for (; i < n; i++) {
+		b[o] = b[i];
+		o += !sb_xform_is_ctrl((unsigned char)b[i]);
+	}
+	const size_t removed = n - o;
+	sb_xform_truncate(sb, o);
+	return removed;
+}
+
+size_t sb_collapse_space(string_builder *sb) {
+	if (sb == NULL || sb->buf == NULL) { return 0; }
+	char *b = sb->buf;
+	const size_t n = sb->len;
+	size_t i = 0;
+	size_t o = 0;
+	bool prev = false;
+#ifdef SB_XFORM_X86
+	if (sb_xform_avx2()) {
+		i = sb_xform_collapse_avx2(b, n, &o, &prev);
+	}
+#endif // SB_XFORM_X86
+#ifdef __SSE2__
+	for (; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(b + i));
+		const __m128i sp = sb_xform_space_sse2(v);
+		const uint32_t ws = (uint32_t)_mm_movemask_epi8(sp);
+		const uint32_t drop = ws & (ws << 1 | (uint32_t)prev);
+		prev = (ws >> 15) & 1;
+		const __m128i r = _mm_or_si128(_mm_and_si128(sp, _mm_set1_epi8(' ')), _mm_andnot_si128(sp, v));
+		if (drop == 0) {
+			_mm_storeu_si128((__m128i *)(b + o), r);
+			o += 16;
+		} else {
+			char tmp[16];
+			_mm_storeu_si128((__m128i *)tmp, r);
+			o += sb_xform_pack(b + o, tmp, 16, drop);
+		}
+	}
+#endif // __SSE2__
+	for (; i < n; i++) {
+		const bool ws = sb_xform_is_space((unsigned char)b[i]);
+		if (!(ws && prev)) {
+			b[o++] = ws ? ' ' : b[i];
+		}
+		prev = ws;
+	}
+	const size_t removed = n - o;
+	sb_xform_truncate(sb, o);
+	return removed;
+}
+
+#endif // SB_XFORM_IMPLEMENTATION
+
+#endif // SB_XFORM_H
@@ -0,0 +1,262 @@
+#ifndef SPLIT_H
+#define SPLIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sb.h"
+
+#define SPLIT_SKIP_EMPTY (1 << 0) // Do not yield empty tokens.
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Split iterator. Yields the tokens between delimiters as slices of the input,
+ * so nothing is copied. Delimiters are located 64 bytes at a time with SIMD,
+ * and the positions are kept as a bit mask between calls.
+ */
+typedef struct sb_split {
+	const char *ptr;   // The input.
+	size_t len;        // The input's length.
+	size_t pos;        // The start of the next token.
+	size_t block;      // The offset of the 64-byte block `mask` describes.
+	uint64_t mask;     // The unconsumed delimiters in the block.
+	uint8_t nib[32];   // Delimiter bits, indexed by low nibble; see `sb_split_init`.
+	char delim;        // The delimiter when there is only one.
+	bool single;       // Whether there is only one delimiter.
+	int simd;          // The instruction set to scan with.
+	unsigned flags;    // `SPLIT_*` flags.
+	bool done;         // Whether the last token has been yielded.
+} sb_split;
+
+/**
+ * Initializes a split iterator. Without `SPLIT_SKIP_EMPTY`, `n` delimiters in
+ * the input yield `n + 1` tokens, some of which may be empty.
+ * @param it     Split iterator pointer.
+ * @param s      The input, e.g. `sb_as_slice(&sb)`. It must outlive the
+ *               iterator and the tokens.
+ * @param delims The delimiter bytes; any one of them ends a token.
+ * @param n      The number of delimiter bytes.
+ * @param flags  `SPLIT_*` flags.
+ */
+void sb_split_init(sb_split *it, sb_slice s, const char *delims, size_t n, unsigned flags);
+
+/**
+ * Gets the next token.
+ * @param it  Split iterator pointer.
+ * @param tok Receives the token.
+ * @return `true` if a token was yielded; otherwise, `false` at the end.
+ */
+bool sb_split_next(sb_split *it, sb_slice *tok);
+
+#ifdef ARENA_H
+/**
+ * Splits the whole input in one pass into an array of slices allocated in an
+ * arena. The array grows in place while it is the arena's latest allocation.
+ * @param a      Arena pointer.
+ * @param s      The input.
+ * @param delims The delimiter bytes.
+ * @param n      The number of delimiter bytes.
+ * @param flags  `SPLIT_*` flags.
+ * @param out    Receives the array of tokens.
+ * @param count  Receives the number of tokens.
+ * @return `true` on success; otherwise, `false` if the arena is full.
+ */
+bool sb_split_all(arena *a, sb_slice s, const char *delims, size_t n, unsigned flags, sb_slice **out, size_t *count);
+#endif // ARENA_H
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef SPLIT_IMPLEMENTATION
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPLIT_X86
+#include <immintrin.h>
+#endif // x86 && (GCC || Clang)
+
+enum { SPLIT_SCALAR, SPLIT_SSE2, SPLIT_SSSE3, SPLIT_AVX2 };
+
+// A byte `c` is a delimiter if bit `(c >> 4) & 7` of `nib[(c >> 7) * 16 + (c & 15)]`
+// is set. This layout lets pshufb classify 16 bytes with two table lookups.
+static bool sb_split_is_delim(const uint8_t *nib, const unsigned char c) {
+	return (nib[(c >> 7) * 16 + (c & 15)] >> ((c >> 4) & 7)) & 1;
+}
+
+#ifdef SPLIT_X86
+__attribute__((target("sse2")))
+static uint64_t sb_split_mask_sse2(const char *p, const char delim) {
+	const __m128i d = _mm_set1_epi8(delim);
+	uint64_t mask = 0;
+	for (int k = 0; k < 4; k++) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+		mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, d)) << (16 * k);
+	}
+	return mask;
+}
+
+__attribute__((target("ssse3")))
+static uint64_t sb_split_mask_ssse3(const char *p, const uint8_t *nib) {
+	const __m128i lo_tbl = _mm_loadu_si128((const __m128i *)nib);
+	const __m128i hi_tbl = _mm_loadu_si128((const __m128i *)(nib + 16));
+	const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m128i low = _mm_set1_epi8(0x0F);
+	uint64_t mask = 0;
+	for (int k = 0; k < 4; k++) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+		const __m128i lo = _mm_and_si128(v, low);
+		const __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), low));
+		// Bytes with the top bit set use the second table.
+		const __m128i high = _mm_cmplt_epi8(v, _mm_setzero_si128());
+		const __m128i row = _mm_or_si128(_mm_andnot_si128(high, _mm_shuffle_epi8(lo_tbl, lo)),
+			_mm_and_si128(high, _mm_shuffle_epi8(hi_tbl, lo)));
+		const __m128i hit = _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+		mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hit) << (16 * k);
+	}
+	return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t sb_split_mask_avx2(const char *p, const uint8_t *nib, const bool single, const char delim) {
+	const __m256i a = _mm256_loadu_si256((const __m256i *)p);
+	const __m256i b = _mm256_loadu_si256((const __m256i *)(p + 32));
+	if (single) {
+		const __m256i d = _mm256_set1_epi8(delim);
+		return (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, d))
+			| (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, d)) << 32;
+	}
+	const __m256i lo_tbl = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)nib));
+	const __m256i hi_tbl = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(nib + 16)));
+	const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m256i low = _mm256_set1_epi8(0x0F);
+	uint64_t mask = 0;
+	const __m256i vs[2] = { a, b };
+	for (int k = 0; k < 2; k++) {
+		const __m256i v = vs[k];
+		const __m256i lo = _mm256_and_si256(v, low);
+		const __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+		const __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(lo_tbl, lo), _mm256_shuffle_epi8(hi_tbl, lo), v);
+		const __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+		mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(hit) << (32 * k);
+	}
+	return mask;
+}
+#endif // SPLIT_X86
+
+// Gets the delimiter mask of the 64-byte block at `it->block`.
+static uint64_t sb_split_scan(const sb_split *it) {
+	const size_t left = it->len - it->block;
+	const char *p = it->ptr + it->block;
+	char tail[64];
+	if (left < 64) {
+		// Pad the last block; the padding is masked off below.
+		memcpy(tail, p, left);
+		memset(tail + left, 0, 64 - left);
+		p = tail;
+	}
+	uint64_t mask = 0;
+	switch (it->simd) {
+#ifdef SPLIT_X86
+	case SPLIT_AVX2:
+		mask = sb_split_mask_avx2(p, it->nib, it->single, it->delim);
+		break;
+	case SPLIT_SSSE3:
+		mask = it->single ? sb_split_mask_sse2(p, it->delim) : sb_split_mask_ssse3(p, it->nib);
+		break;
+	case SPLIT_SSE2:
+		mask = sb_split_mask_sse2(p, it->delim);
+		break;
+#endif // SPLIT_X86
+	default:
+		for (int i = 0; i < 64; i++) {
+			mask |= (uint64_t)sb_split_is_delim(it->nib, (unsigned char)p[i]) << i;
+		}
+	}
+	return left < 64 ? mask & (((uint64_t)1 << left) - 1) : mask;
+}
+
+void sb_split_init(sb_split *it, sb_slice s, const char *delims, size_t n, unsigned flags) {
+	it->ptr = s.ptr;
+	it->len = s.len;
+	it->pos = 0;
+	it->block = 0;
+	it->flags = flags;
+	it->done = false;
+	memset(it->nib, 0, sizeof(it->nib));
+	for (size_t i = 0; i < n; i++) {
+		const unsigned char c = (unsigned char)delims[i];
+		it->nib[(c >> 7) * 16 + (c & 15)] |= (uint8_t)(1 << ((c >> 4) & 7));
+	}
+	it->single = n == 1;
+	it->delim = n == 1 ? delims[0] : 0;
+	it->simd = SPLIT_SCALAR;
+#ifdef SPLIT_X86
+	if (__builtin_cpu_supports("avx2")) {
+		it->simd = SPLIT_AVX2;
+	} else if (__builtin_cpu_supports("ssse3")) {
+		it->simd = SPLIT_SSSE3;
+	} else if (it->single && __builtin_cpu_supports("sse2")) {
+		it->simd = SPLIT_SSE2;
+	}
+#endif // SPLIT_X86
+	it->mask = it->len > 0 ? sb_split_scan(it) : 0;
+}
+
+bool sb_split_next(sb_split *it, sb_slice *tok) {
+	while (!it->done) {
+		while (it->mask == 0 && it->block + 64 < it->len) {
+			it->block += 64;
+			it->mask = sb_split_scan(it);
+		}
+		size_t end;
+		if (it->mask != 0) {
+			end = it->block + (size_t)__builtin_ctzll(it->mask);
+			it->mask &= it->mask - 1;
+		} else {
+			end = it->len;
+			it->done = true;
+		}
+		tok->ptr = it->ptr + it->pos;
+		tok->len = end - it->pos;
+		it->pos = end + 1;
+		if (tok->len > 0 || !(it->flags & SPLIT_SKIP_EMPTY)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef ARENA_H
+bool sb_split_all(arena *a, sb_slice s, const char *delims, size_t n, unsigned flags, sb_slice **out, size_t *count) {
+	sb_split it;
+	sb_split_init(&it, s, delims, n, flags);
+	size_t cap = 16;
+	size_t len = 0;
+	sb_slice *toks = (sb_slice *)arena_alloc(a, cap * sizeof(sb_slice));
+	if (toks == NULL) { return false; }
+	sb_slice tok;
+	while (sb_split_next(&it, &tok)) {
+		if (len == cap) {
+			sb_slice *grown = (sb_slice *)arena_realloc(a, toks, cap * sizeof(sb_slice), 2 * cap * sizeof(sb_slice));
+			if (grown == NULL) { return false; }
+			toks = grown;
+			cap *= 2;
+		}
+		toks[len++] = tok;
+	}
+	*out = toks;
+	*count = len;
+	return true;
+}
+#endif // ARENA_H
+
+#endif // SPLIT_IMPLEMENTATION
+
+#endif // SPLIT_H
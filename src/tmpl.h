@@ -0,0 +1,520 @@
+#ifndef TMPL_H
+#define TMPL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "arena.h"
+#include "sb.h"
+
+// The deepest that sections may be nested.
+#ifndef TMPL_MAX_DEPTH
+#define TMPL_MAX_DEPTH 32
+#endif // TMPL_MAX_DEPTH
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Template value types.
+ */
+typedef enum tmpl_type {
+	TMPL_NULL,
+	TMPL_BOOL,
+	TMPL_INT,
+	TMPL_STR,
+	TMPL_LIST,
+	TMPL_OBJ,
+} tmpl_type;
+
+typedef struct tmpl_field tmpl_field;
+
+/**
+ * A value in a template's data context. Values only point to their data, so
+ * a context can be built on the stack without allocating.
+ */
+typedef struct tmpl_value {
+	tmpl_type type;
+	union {
+		bool b;      // `TMPL_BOOL`.
+		long long i; // `TMPL_INT`.
+		sb_slice s;  // `TMPL_STR`.
+		struct {
+			const struct tmpl_value *items;
+			size_t len;
+		} list;      // `TMPL_LIST`.
+		struct {
+			const tmpl_field *fields;
+			size_t len;
+		} obj;       // `TMPL_OBJ`.
+	} u;
+} tmpl_value;
+
+/**
+ * A named value in an object.
+ */
+struct tmpl_field {
+	const char *key;  // The name.
+	size_t key_len;   // The length of the name.
+	tmpl_value value; // The value.
+};
+
+// Initializes a field with a string literal name, e.g. `TMPL_FIELD("title", tmpl_str(title))`.
+#define TMPL_FIELD(key, value) { key, sizeof(key) - 1, value }
+
+/**
+ * Template instruction kinds.
+ */
+enum {
+	TMPL_OP_TEXT,     // Writes literal text.
+	TMPL_OP_VAR,      // Writes a variable, HTML-escaped.
+	TMPL_OP_RAW,      // Writes a variable as is.
+	TMPL_OP_SECTION,  // Renders the ops up to `end` for each item, or once if truthy.
+	TMPL_OP_INVERTED, // Renders the ops up to `end` once if falsy.
+};
+
+/**
+ * Template instruction.
+ */
+typedef struct tmpl_op {
+	const char *ptr; // The literal text, or the variable or section name.
+	size_t len;      // The length of `ptr`.
+	unsigned kind;   // `TMPL_OP_*`.
+	size_t end;      // For a section, the index of the op after it.
+} tmpl_op;
+
+/**
+ * Compiled template.
+ */
+typedef struct tmpl {
+	const tmpl_op *ops; // The instructions.
+	size_t n;           // The number of instructions.
+} tmpl;
+
+static inline tmpl_value tmpl_null(void) {
+	tmpl_value v;
+	v.type = TMPL_NULL;
+	return v;
+}
+
+static inline tmpl_value tmpl_bool(bool b) {
+	tmpl_value v;
+	v.type = TMPL_BOOL;
+	v.u.b = b;
+	return v;
+}
+
+static inline tmpl_value tmpl_int(long long i) {
+	tmpl_value v;
+	v.type = TMPL_INT;
+	v.u.i = i;
+	return v;
+}
+
+static inline tmpl_value tmpl_strn(const char *s, size_t n) {
+	tmpl_value v;
+	v.type = TMPL_STR;
+	v.u.s.ptr = s;
+	v.u.s.len = n;
+	return v;
+}
+
+static inline tmpl_value tmpl_str(const char *s) {
+	return tmpl_strn(s, strlen(s));
+}
+
+static inline tmpl_value tmpl_list(const tmpl_value *items, size_t n) {
+	tmpl_value v;
+	v.type = TMPL_LIST;
+	v.u.list.items = items;
+	v.u.list.len = n;
+	return v;
+}
+
+static inline tmpl_value tmpl_obj(const tmpl_field *fields, size_t n) {
+	tmpl_value v;
+	v.type = TMPL_OBJ;
+	v.u.obj.fields = fields;
+	v.u.obj.len = n;
+	return v;
+}
+
+/**
+ * Compiles a Mustache-style template into instructions allocated in an arena.
+ * The source is copied, so it need not outlive the template.
+ *
+ * Tags are `{{name}}` (HTML-escaped), `{{{name}}}` or `{{&name}}` (raw),
+ * `{{#name}}...{{/name}}` (a loop over a list, or a conditional),
+ * `{{^name}}...{{/name}}` (rendered if `name` is falsy) and `{{!comment}}`.
+ * `{{.}}` is the current item and `a.b` looks up `b` in `a`. Section and
+ * comment tags on a line of their own do not leave a blank line behind.
+ * @param t       Template pointer.
+ * @param a       Arena pointer.
+ * @param src     The template source.
+ * @param n       The length of the source.
+ * @param err_off Receives the offset of the first syntax error; may be `NULL`.
+ * @return `true` on success; otherwise, `false` on a syntax error, nesting
+ *         deeper than `TMPL_MAX_DEPTH` or if the arena is full.
+ */
+bool tmpl_compile(tmpl *t, arena *a, const char *src, size_t n, size_t *err_off);
+
+/**
+ * Renders a compiled template against a data context. Nothing is parsed or
+ * allocated; literal text is copied with its precomputed length and
+ * variables are escaped with SIMD.
+ *
+ * Names are looked up in the innermost section's object first, then in the
+ * enclosing ones. Missing names render as nothing. `TMPL_INT` values render
+ * in decimal and `TMPL_BOOL` values as `true` or `false`. Sections render
+ * once for a truthy value (a `true` boolean, a non-zero integer, a non-empty
+ * string or an object) and once per item for a list.
+ * @param t   Template pointer.
+ * @param ctx The data context, usually an object.
+ * @param sb  String builder pointer.
+ * @return `true` on success; otherwise, `false` if a write failed.
+ */
+bool tmpl_render(const tmpl *t, const tmpl_value *ctx, string_builder *sb);
+
+/**
+ * Writes bytes with `&`, `<`, `>`, `"` and `'` escaped as HTML entities.
+ * @param sb String builder pointer.
+ * @param s  Bytes to write.
+ * @param n  The number of bytes to write.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool sb_write_html(string_builder *sb, const char *s, size_t n);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef TMPL_IMPLEMENTATION
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+// The number of input bytes escaped per reservation. Each may take 6 bytes.
+#define TMPL_ESCAPE_CHUNK 512
+
+// Gets the number of leading bytes that need no escaping.
+static size_t tmpl_clean_run(const char *s, const size_t n) {
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i amp = _mm_set1_epi8('&');
+	const __m128i lt = _mm_set1_epi8('<');
+	const __m128i gt = _mm_set1_epi8('>');
+	const __m128i dq = _mm_set1_epi8('"');
+	const __m128i sq = _mm_set1_epi8('\'');
+	for (; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		const __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, lt)),
+			_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, gt), _mm_cmpeq_epi8(v, dq)), _mm_cmpeq_epi8(v, sq)));
+		const unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+		if (mask != 0) {
+			return i + (size_t)__builtin_ctz(mask);
+		}
+	}
+#endif // __SSE2__
+	for (; i < n; i++) {
+		const char c = s[i];
+		if (c == '&' || c == '<' || c == '>' || c == '"' || c == '\'') { break; }
+	}
+	return i;
+}
+
+bool sb_write_html(string_builder *sb, const char *s, size_t n) {
+	while (n > 0) {
+		const size_t chunk = n < TMPL_ESCAPE_CHUNK ? n : TMPL_ESCAPE_CHUNK;
+		char *dst = sb_reserve(sb, chunk * 6);
+		if (dst == NULL) { return false; }
+		char *o = dst;
+		size_t i = 0;
+		while (i < chunk) {
+			const size_t run = tmpl_clean_run(s + i, chunk - i);
+			memcpy(o, s + i, run);
+			o += run;
+			i += run;
+			if (i == chunk) { break; }
+			const char *ent;
+			size_t ent_len;
+			switch (s[i]) {
+			case '&': ent = "&amp;"; ent_len = 5; break;
+			case '<': ent = "&lt;"; ent_len = 4; break;
+			case '>': ent = "&gt;"; ent_len = 4; break;
+			case '"': ent = "&quot;"; ent_len = 6; break;
+			default: ent = "&#39;"; ent_len = 5; break;
+			}
+			memcpy(o, ent, ent_len);
+			o += ent_len;
+			i++;
+		}
+		sb_advance(sb, (size_t)(o - dst));
+		s += chunk;
+		n -= chunk;
+	}
+	return true;
+}
+
+static bool tmpl_is_blank(const char c) {
+	return c == ' ' || c == '\t';
+}
+
+// Appends an op, doubling the array in place while it is the arena's latest allocation.
+static bool tmpl_push(arena *a, tmpl_op **ops, size_t *len, size_t *cap, const tmpl_op op) {
+	if (*len == *cap) {
+		tmpl_op *grown = (tmpl_op *)arena_realloc(a, *ops, *cap * sizeof(tmpl_op), 2 * *cap * sizeof(tmpl_op));
+		if (grown == NULL) { return false; }
+		*ops = grown;
+		*cap *= 2;
+	}
+	(*ops)[(*len)++] = op;
+	return true;
+}
+
+bool tmpl_compile(tmpl *t, arena *a, const char *src, size_t n, size_t *err_off) {
+	size_t err = 0;
+	char *s = n > 0 ? (char *)arena_memdup(a, src, n) : NULL;
+	size_t cap = 16;
+	size_t len = 0;
+	tmpl_op *ops = (tmpl_op *)arena_alloc(a, cap * sizeof(tmpl_op));
+	size_t open[TMPL_MAX_DEPTH]; // The indices of the unclosed sections.
+	size_t depth = 0;
+	size_t lit = 0;              // The start of the pending literal text.
+	size_t i = 0;
+	if ((n > 0 && s == NULL) || ops == NULL) { goto fail; }
+	while (i < n) {
+		const char *p = (const char *)memchr(s + i, '{', n - i);
+		if (p == NULL) { break; }
+		size_t ts = (size_t)(p - s);
+		if (ts + 1 >= n || s[ts+1] != '{') {
+			i = ts + 1;
+			continue;
+		}
+		// Parse the tag: [ts, te) is the whole tag, [ns, ne) the name.
+		size_t ns = ts + 2;
+		unsigned kind = TMPL_OP_VAR;
+		char sigil = 0;
+		bool triple = false;
+		if (ns < n && s[ns] == '{') {
+			triple = true;
+			kind = TMPL_OP_RAW;
+			ns++;
+		} else if (ns < n && (s[ns] == '&' || s[ns] == '#' || s[ns] == '^' || s[ns] == '/' || s[ns] == '!')) {
+			sigil = s[ns++];
+		}
+		const char *close = NULL;
+		for (size_t j = ns; j + 1 < n; j++) {
+			if (s[j] == '}' && s[j+1] == '}') {
+				close = s + j;
+				break;
+			}
+		}
+		if (close == NULL || (triple && ((size_t)(close - s) + 2 >= n || close[2] != '}'))) {
+			err = ts;
+			goto fail;
+		}
+		size_t ne = (size_t)(close - s);
+		size_t te = ne + (triple ? 3 : 2);
+		if (sigil != '!') {
+			while (ns < ne && tmpl_is_blank(s[ns])) { ns++; }
+			while (ne > ns && tmpl_is_blank(s[ne-1])) { ne--; }
+			if (ns == ne) {
+				err = ts;
+				goto fail;
+			}
+		}
+		// Standalone section and comment tags swallow their line.
+		size_t lit_end = ts;
+		if (sigil == '#' || sigil == '^' || sigil == '/' || sigil == '!') {
+			size_t ls = ts;
+			while (ls > 0 && tmpl_is_blank(s[ls-1])) { ls--; }
+			size_t le = te;
+			while (le < n && tmpl_is_blank(s[le])) { le++; }
+			if ((ls == 0 || s[ls-1] == '\n') && (le == n || s[le] == '\n' || (s[le] == '\r' && le + 1 < n && s[le+1] == '\n'))) {
+				lit_end = ls;
+				te = le == n ? n : le + (s[le] == '\r' ? 2 : 1);
+			}
+		}
+		if (lit_end > lit) {
+			const tmpl_op text = { s + lit, lit_end - lit, TMPL_OP_TEXT, 0 };
+			if (!tmpl_push(a, &ops, &len, &cap, text)) { goto fail; }
+		}
+		lit = te;
+		i = te;
+		if (sigil == '!') { continue; }
+		if (sigil == '/') {
+			if (depth == 0) {
+				err = ts;
+				goto fail;
+			}
+			tmpl_op *sec = &ops[open[depth-1]];
+			if (sec->len != ne - ns || memcmp(sec->ptr, s + ns, sec->len) != 0) {
+				err = ts;
+				goto fail;
+			}
+			sec->end = len;
+			depth--;
+			continue;
+		}
+		if (sigil == '&') {
+			kind = TMPL_OP_RAW;
+		} else if (sigil == '#' || sigil == '^') {
+			if (depth == TMPL_MAX_DEPTH) {
+				err = ts;
+				goto fail;
+			}
+			kind = sigil == '#' ? TMPL_OP_SECTION : TMPL_OP_INVERTED;
+			open[depth++] = len;
+		}
+		const tmpl_op op = { s + ns, ne - ns, kind, 0 };
+		if (!tmpl_push(a, &ops, &len, &cap, op)) { goto fail; }
+	}
+	if (depth > 0) {
+		err = (size_t)(ops[open[depth-1]].ptr - s);
+		goto fail;
+	}
+	if (n > lit) {
+		const tmpl_op text = { s + lit, n - lit, TMPL_OP_TEXT, 0 };
+		if (!tmpl_push(a, &ops, &len, &cap, text)) { goto fail; }
+	}
+	t->ops = ops;
+	t->n = len;
+	return true;
+fail:
+	if (err_off != NULL) {
+		*err_off = err;
+	}
+	t->ops = NULL;
+	t->n = 0;
+	return false;
+}
+
+static const tmpl_value *tmpl_field_of(const tmpl_value *v, const char *key, const size_t len) {
+	if (v->type != TMPL_OBJ) { return NULL; }
+	for (size_t i = 0; i < v->u.obj.len; i++) {
+		const tmpl_field *f = &v->u.obj.fields[i];
+		if (f->key_len == len && memcmp(f->key, key, len) == 0) {
+			return &f->value;
+		}
+	}
+	return NULL;
+}
+
+// Resolves a dotted name against the context stack, innermost first.
+static const tmpl_value *tmpl_lookup(const tmpl_value *const *stack, const size_t depth, const char *name, size_t len) {
+	if (len == 1 && name[0] == '.') {
+		return stack[depth-1];
+	}
+	const char *dot = (const char *)memchr(name, '.', len);
+	size_t seg = dot != NULL ? (size_t)(dot - name) : len;
+	const tmpl_value *v = NULL;
+	for (size_t d = depth; d-- > 0 && v == NULL;) {
+		v = tmpl_field_of(stack[d], name, seg);
+	}
+	while (v != NULL && seg < len) {
+		name += seg + 1;
+		const size_t rest = len - seg - 1;
+		dot = (const char *)memchr(name, '.', rest);
+		const size_t next = dot != NULL ? (size_t)(dot - name) : rest;
+		v = tmpl_field_of(v, name, next);
+		seg = next;
+		len = rest;
+	}
+	return v;
+}
+
+static bool tmpl_truthy(const tmpl_value *v) {
+	if (v == NULL) { return false; }
+	switch (v->type) {
+	case TMPL_BOOL: return v->u.b;
+	case TMPL_INT: return v->u.i != 0;
+	case TMPL_STR: return v->u.s.len > 0;
+	case TMPL_LIST: return v->u.list.len > 0;
+	case TMPL_OBJ: return true;
+	default: return false;
+	}
+}
+
+static bool tmpl_write_value(string_builder *sb, const tmpl_value *v, const bool escape) {
+	if (v == NULL) { return true; }
+	switch (v->type) {
+	case TMPL_STR:
+		if (escape) {
+			return sb_write_html(sb, v->u.s.ptr, v->u.s.len);
+		}
+		return v->u.s.len == 0 || sb_writen(sb, v->u.s.ptr, v->u.s.len) == v->u.s.len;
+	case TMPL_INT: {
+		char digits[24];
+		char *p = digits + sizeof(digits);
+		unsigned long long u = v->u.i < 0 ? 0ULL - (unsigned long long)v->u.i : (unsigned long long)v->u.i;
+		do {
+			*--p = (char)('0' + u % 10);
+			u /= 10;
+		} while (u != 0);
+		if (v->u.i < 0) {
+			*--p = '-';
+		}
+		const size_t n = (size_t)(digits + sizeof(digits) - p);
+		return sb_writen(sb, p, n) == n;
+	}
+	case TMPL_BOOL:
+		return v->u.b ? sb_writen(sb, "true", 4) == 4 : sb_writen(sb, "false", 5) == 5;
+	default:
+		return true;
+	}
+}
+
+static bool tmpl_run(const tmpl_op *ops, size_t i, const size_t end, const tmpl_value **stack, const size_t depth, string_builder *sb) {
+	while (i < end) {
+		const tmpl_op *op = &ops[i];
+		switch (op->kind) {
+		case TMPL_OP_TEXT:
+			if (sb_writen(sb, op->ptr, op->len) != op->len) { return false; }
+			i++;
+			break;
+		case TMPL_OP_VAR:
+		case TMPL_OP_RAW:
+			if (!tmpl_write_value(sb, tmpl_lookup(stack, depth, op->ptr, op->len), op->kind == TMPL_OP_VAR)) {
+				return false;
+			}
+			i++;
+			break;
+		case TMPL_OP_SECTION: {
+			const tmpl_value *v = tmpl_lookup(stack, depth, op->ptr, op->len);
+			if (v != NULL && v->type == TMPL_LIST) {
+				for (size_t k = 0; k < v->u.list.len; k++) {
+					stack[depth] = &v->u.list.items[k];
+					if (!tmpl_run(ops, i + 1, op->end, stack, depth + 1, sb)) { return false; }
+				}
+			} else if (tmpl_truthy(v)) {
+				stack[depth] = v;
+				if (!tmpl_run(ops, i + 1, op->end, stack, depth + 1, sb)) { return false; }
+			}
+			i = op->end;
+			break;
+		}
+		case TMPL_OP_INVERTED:
+			if (!tmpl_truthy(tmpl_lookup(stack, depth, op->ptr, op->len))) {
+				if (!tmpl_run(ops, i + 1, op->end, stack, depth, sb)) { return false; }
+			}
+			i = op->end;
+			break;
+		default:
+			i++;
+		}
+	}
+	return true;
+}
+
+bool tmpl_render(const tmpl *t, const tmpl_value *ctx, string_builder *sb) {
+	const tmpl_value *stack[TMPL_MAX_DEPTH + 1];
+	stack[0] = ctx;
+	return tmpl_run(t->ops, 0, t->n, stack, 1, sb);
+}
+
+#endif // TMPL_IMPLEMENTATION
+
+#endif // TMPL_H
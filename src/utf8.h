@@ -0,0 +1,432 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+ * Validates UTF-8 (RFC 3629: no overlong forms, surrogates or code points
+ * above U+10FFFF). Uses AVX2 or SSSE3 when the CPU supports them.
+ * @param s       Bytes to validate.
+ * @param n       The number of bytes.
+ * @param err_off Receives the offset of the first byte of the first invalid
+ *                sequence on failure. May be `NULL`.
+ * @return `true` if the bytes are valid UTF-8; otherwise, `false`.
+ */
+bool utf8_validate(const char *s, size_t n, size_t *err_off);
+
+/**
+ * Transcodes Latin-1 (ISO-8859-1) to UTF-8.
+ * @param dst Destination with room for at least `2 * n` bytes.
+ * @param src Latin-1 bytes.
+ * @param n   The number of bytes.
+ * @return The number of bytes written to `dst`.
+ */
+size_t utf8_from_latin1(char *dst, const char *src, size_t n);
+
+/**
+ * Transcodes native-endian UTF-16 to UTF-8.
+ * @param dst     Destination with room for at least `3 * n` bytes.
+ * @param src     UTF-16 code units.
+ * @param n       The number of code units.
+ * @param out_len Receives the number of bytes written to `dst`.
+ * @param err_off Receives the index of the first unpaired surrogate on
+ *                failure. May be `NULL`.
+ * @return `true` on success; otherwise, `false`.
+ */
+bool utf8_from_utf16(char *dst, const uint16_t *src, size_t n, size_t *out_len, size_t *err_off);
+
+/**
+ * Validates UTF-8 and writes it to the string builder. Nothing is written if
+ * the bytes are invalid.
+ * @param sb      String builder pointer.
+ * @param s       Bytes to write.
+ * @param n       The number of bytes.
+ * @param err_off Receives the offset of the first invalid sequence on failure.
+ *                May be `NULL`.
+ * @return `true` if the bytes were valid and written; otherwise, `false`.
+ */
+bool sb_write_utf8(string_builder *sb, const char *s, size_t n, size_t *err_off);
+
+/**
+ * Transcodes Latin-1 to UTF-8 directly into the string builder.
+ * @param sb String builder pointer.
+ * @param s  Latin-1 bytes.
+ * @param n  The number of bytes.
+ * @return The number of bytes written.
+ */
+size_t sb_write_latin1(string_builder *sb, const char *s, size_t n);
+
+/**
+ * Transcodes native-endian UTF-16 to UTF-8 directly into the string builder.
+ * Nothing is written if the input has an unpaired surrogate.
+ * @param sb      String builder pointer.
+ * @param s       UTF-16 code units.
+ * @param n       The number of code units.
+ * @param err_off Receives the index of the first unpaired surrogate on
+ *                failure. May be `NULL`.
+ * @return `true` if the input was valid and written; otherwise, `false`.
+ */
+bool sb_write_utf16(string_builder *sb, const uint16_t *s, size_t n, size_t *err_off);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#ifdef UTF8_IMPLEMENTATION
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define UTF8_X86
+#include <immintrin.h>
+#endif // x86 && (GCC || Clang)
+
+// Returns the offset of the first invalid sequence, or `n` if there is none.
+static size_t utf8_scalar_error(const unsigned char *s, const size_t n) {
+	size_t i = 0;
+	while (i < n) {
+		// Skip ASCII a word at a time.
+		while (i + 8 <= n) {
+			uint64_t w;
+			memcpy(&w, s + i, 8);
+			if (w & 0x8080808080808080ull) { break; }
+			i += 8;
+		}
+		if (i >= n) { break; }
+		const unsigned char c = s[i];
+		if (c < 0x80) {
+			i++;
+			continue;
+		}
+		size_t len;
+		unsigned char lo = 0x80, hi = 0xBF; // The range of the second byte.
+		if (c >= 0xC2 && c <= 0xDF) {
+			len = 2;
+		} else if (c >= 0xE0 && c <= 0xEF) {
+			len = 3;
+			if (c == 0xE0) { lo = 0xA0; }
+			if (c == 0xED) { hi = 0x9F; }
+		} else if (c >= 0xF0 && c <= 0xF4) {
+			len = 4;
+			if (c == 0xF0) { lo = 0x90; }
+			if (c == 0xF4) { hi = 0x8F; }
+		} else {
+			return i;
+		}
+		if (n - i < len || s[i+1] < lo || s[i+1] > hi) { return i; }
+		for (size_t k = 2; k < len; k++) {
+			if ((s[i+k] & 0xC0) != 0x80) { return i; }
+		}
+		i += len;
+	}
+	return n;
+}
+
+#ifdef UTF8_X86
+// Error classes of the lookup-table algorithm by Keiser and Lemire,
+// "Validating UTF-8 In Less Than One Instruction Per Byte" (2021). Each table
+// maps a nibble to the classes it can take part in; a class is an error only
+// if all three nibbles agree.
+#define UTF8_TOO_SHORT  (1 << 0) // 11______ 0_______ or 11______ 11______
+#define UTF8_TOO_LONG   (1 << 1) // 0_______ 10______
+#define UTF8_OVERLONG_3 (1 << 2) // 11100000 100_____
+#define UTF8_TOO_LARGE  (1 << 3) // 11110100 1001____ and above
+#define UTF8_SURROGATE  (1 << 4) // 11101101 101_____
+#define UTF8_OVERLONG_2 (1 << 5) // 1100000_ 10______
+#define UTF8_TOO_LARGE_1000 (1 << 6) // 11110101 1000____ and above
+#define UTF8_OVERLONG_4 (1 << 6) // 11110000 1000____
+#define UTF8_TWO_CONTS  ((char)(1 << 7)) // 10______ 10______
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_BYTE_1_HIGH \
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+	UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, \
+	UTF8_TOO_SHORT | UTF8_OVERLONG_2, \
+	UTF8_TOO_SHORT, \
+	UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE, \
+	UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+
+#define UTF8_BYTE_1_LOW \
+	UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4, \
+	UTF8_CARRY | UTF8_OVERLONG_2, \
+	UTF8_CARRY, \
+	UTF8_CARRY, \
+	UTF8_CARRY | UTF8_TOO_LARGE, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+
+#define UTF8_BYTE_2_HIGH \
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4, \
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE, \
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+
+// The largest byte that can end a block without being an incomplete sequence.
+#define UTF8_INCOMPLETE_MAX \
+	-1, -1, -1, -1, -1, -1, -1, -1, \
+	-1, -1, -1, -1, -1, (char)0xEF, (char)0xDF, (char)0xBF
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_check_ssse3(const __m128i in, const __m128i prev) {
+	const __m128i nib = _mm_set1_epi8(0x0F);
+	const __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+	const __m128i b1h = _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE_1_HIGH),
+		_mm_and_si128(_mm_srli_epi16(prev1, 4), nib));
+	const __m128i b1l = _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE_1_LOW), _mm_and_si128(prev1, nib));
+	const __m128i b2h = _mm_shuffle_epi8(_mm_setr_epi8(UTF8_BYTE_2_HIGH),
+		_mm_and_si128(_mm_srli_epi16(in, 4), nib));
+	const __m128i special = _mm_and_si128(_mm_and_si128(b1h, b1l), b2h);
+	// Third and fourth bytes of multi-byte sequences must be continuations.
+	const __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+	const __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+	const __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80))),
+		_mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80))));
+	const __m128i must23_80 = _mm_and_si128(must23, _mm_set1_epi8((char)0x80));
+	return _mm_xor_si128(must23_80, special);
+}
+
+// Returns the start of the first 16-byte block with an error, or `n`.
+__attribute__((target("ssse3")))
+static size_t utf8_error_block_ssse3(const unsigned char *s, const size_t n) {
+	const __m128i max = _mm_setr_epi8(UTF8_INCOMPLETE_MAX);
+	__m128i prev = _mm_setzero_si128();
+	__m128i prev_incomplete = _mm_setzero_si128();
+	unsigned char tail[16];
+	for (size_t i = 0; i < n; i += 16) {
+		__m128i in;
+		if (n - i >= 16) {
+			in = _mm_loadu_si128((const __m128i *)(s + i));
+		} else {
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, s + i, n - i);
+			in = _mm_loadu_si128((const __m128i *)tail);
+		}
+		__m128i err;
+		if (_mm_movemask_epi8(in) == 0) {
+			err = prev_incomplete;
+		} else {
+			err = utf8_check_ssse3(in, prev);
+			prev_incomplete = _mm_subs_epu8(in, max);
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(err, _mm_setzero_si128())) != 0xFFFF) {
+			return i;
+		}
+		prev = in;
+	}
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(prev_incomplete, _mm_setzero_si128())) != 0xFFFF) {
+		return n > 16 ? (n - 1) & ~(size_t)15 : 0;
+	}
+	return n;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_check_avx2(const __m256i in, const __m256i prev) {
+	const __m256i nib = _mm256_set1_epi8(0x0F);
+	// The previous 16 bytes for the upper lane come from the lower lane of `in`.
+	const __m256i shifted = _mm256_permute2x128_si256(prev, in, 0x21);
+	const __m256i prev1 = _mm256_alignr_epi8(in, shifted, 15);
+	const __m256i b1h = _mm256_shuffle_epi8(_mm256_setr_epi8(UTF8_BYTE_1_HIGH, UTF8_BYTE_1_HIGH),
+		_mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib));
+	const __m256i b1l = _mm256_shuffle_epi8(_mm256_setr_epi8(UTF8_BYTE_1_LOW, UTF8_BYTE_1_LOW),
+		_mm256_and_si256(prev1, nib));
+	const __m256i b2h = _mm256_shuffle_epi8(_mm256_setr_epi8(UTF8_BYTE_2_HIGH, UTF8_BYTE_2_HIGH),
+		_mm256_and_si256(_mm256_srli_epi16(in, 4), nib));
+	const __m256i special = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+	const __m256i prev2 = _mm256_alignr_epi8(in, shifted, 14);
+	const __m256i prev3 = _mm256_alignr_epi8(in, shifted, 13);
+	const __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+		_mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+	const __m256i must23_80 = _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80));
+	return _mm256_xor_si256(must23_80, special);
+}
+
+// Returns the start of the first 32-byte block with an error, or `n`.
+__attribute__((target("avx2")))
+static size_t utf8_error_block_avx2(const unsigned char *s, const size_t n) {
+	const __m256i max = _mm256_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, UTF8_INCOMPLETE_MAX);
+	__m256i prev = _mm256_setzero_si256();
+	__m256i prev_incomplete = _mm256_setzero_si256();
+	unsigned char tail[32];
+	for (size_t i = 0; i < n; i += 32) {
+		__m256i in;
+		if (n - i >= 32) {
+			in = _mm256_loadu_si256((const __m256i *)(s + i));
+		} else {
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, s + i, n - i);
+			in = _mm256_loadu_si256((const __m256i *)tail);
+		}
+		__m256i err;
+		if (_mm256_movemask_epi8(in) == 0) {
+			err = prev_incomplete;
+		} else {
+			err = utf8_check_avx2(in, prev);
+			prev_incomplete = _mm256_subs_epu8(in, max);
+		}
+		if (!_mm256_testz_si256(err, err)) {
+			return i;
+		}
+		prev = in;
+	}
+	if (!_mm256_testz_si256(prev_incomplete, prev_incomplete)) {
+		return n > 32 ? (n - 1) & ~(size_t)31 : 0;
+	}
+	return n;
+}
+#endif // UTF8_X86
+
+bool utf8_validate(const char *s, size_t n, size_t *err_off) {
+	const unsigned char *p = (const unsigned char *)s;
+	size_t start = 0;
+#ifdef UTF8_X86
+	if (__builtin_cpu_supports("avx2")) {
+		start = utf8_error_block_avx2(p, n);
+	} else if (__builtin_cpu_supports("ssse3")) {
+		start = utf8_error_block_ssse3(p, n);
+	}
+	if (start == n) { return true; }
+	// The error may belong to a sequence that began up to three bytes before
+	// the block, so rescan from the first character boundary in that range.
+	const size_t block = start;
+	start = start >= 3 ? start - 3 : 0;
+	while (start < block && (p[start] & 0xC0) == 0x80) {
+		start++;
+	}
+#endif // UTF8_X86
+	const size_t err = start + utf8_scalar_error(p + start, n - start);
+	if (err == n) { return true; }
+	if (err_off != NULL) { *err_off = err; }
+	return false;
+}
+
+size_t utf8_from_latin1(char *dst, const char *src, size_t n) {
+	const unsigned char *s = (const unsigned char *)src;
+	size_t o = 0;
+	size_t i = 0;
+	while (i < n) {
+#ifdef __SSE2__
+		// Copy runs of ASCII 16 bytes at a time.
+		while (i + 16 <= n) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+			if (_mm_movemask_epi8(v) != 0) { break; }
+			_mm_storeu_si128((__m128i *)(dst + o), v);
+			i += 16;
+			o += 16;
+		}
+		if (i >= n) { break; }
+#endif // __SSE2__
+		const unsigned char c = s[i++];
+		if (c < 0x80) {
+			dst[o++] = (char)c;
+		} else {
+			dst[o++] = (char)(0xC0 | (c >> 6));
+			dst[o++] = (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return o;
+}
+
+bool utf8_from_utf16(char *dst, const uint16_t *src, size_t n, size_t *out_len, size_t *err_off) {
+	size_t o = 0;
+	size_t i = 0;
+	while (i < n) {
+#ifdef __SSE2__
+		// Narrow runs of ASCII 8 code units at a time.
+		while (i + 8 <= n) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+			const __m128i high = _mm_and_si128(v, _mm_set1_epi16((short)0xFF80));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF) { break; }
+			_mm_storel_epi64((__m128i *)(dst + o), _mm_packus_epi16(v, v));
+			i += 8;
+			o += 8;
+		}
+		if (i >= n) { break; }
+#endif // __SSE2__
+		uint32_t c = src[i];
+		if (c < 0x80) {
+			dst[o++] = (char)c;
+			i++;
+		} else if (c < 0x800) {
+			dst[o++] = (char)(0xC0 | (c >> 6));
+			dst[o++] = (char)(0x80 | (c & 0x3F));
+			i++;
+		} else if (c < 0xD800 || c > 0xDFFF) {
+			dst[o++] = (char)(0xE0 | (c >> 12));
+			dst[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			dst[o++] = (char)(0x80 | (c & 0x3F));
+			i++;
+		} else {
+			if (c > 0xDBFF || i + 1 >= n || src[i+1] < 0xDC00 || src[i+1] > 0xDFFF) {
+				if (err_off != NULL) { *err_off = i; }
+				return false;
+			}
+			c = 0x10000 + ((c - 0xD800) << 10) + (src[i+1] - 0xDC00);
+			dst[o++] = (char)(0xF0 | (c >> 18));
+			dst[o++] = (char)(0x80 | ((c >> 12) & 0x3F));
+			dst[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+			dst[o++] = (char)(0x80 | (c & 0x3F));
+			i += 2;
+		}
+	}
+	*out_len = o;
+	return true;
+}
+
+bool sb_write_utf8(string_builder *sb, const char *s, size_t n, size_t *err_off) {
+	if (!utf8_validate(s, n, err_off)) {
+		return false;
+	}
+	return sb_writen(sb, s, n) == n;
+}
+
+size_t sb_write_latin1(string_builder *sb, const char *s, size_t n) {
+	char *dst = sb_reserve(sb, 2 * n);
+	if (dst == NULL) {
+		return 0;
+	}
+	const size_t len = utf8_from_latin1(dst, s, n);
+	sb_advance(sb, len);
+	return len;
+}
+
+bool sb_write_utf16(string_builder *sb, const uint16_t *s, size_t n, size_t *err_off) {
+	char *dst = sb_reserve(sb, 3 * n);
+	if (dst == NULL) {
+		return false;
+	}
+	size_t len;
+	if (!utf8_from_utf16(dst, s, n, &len, err_off)) {
+		// Restore the terminator and the zeroed tail that the partial output
+		// overwrote.
+		memset(dst, 0, sb->flags & SB_NOZERO ? 1 : 3 * n);
+		return false;
+	}
+	sb_advance(sb, len);
+	return true;
+}
+
+#endif // UTF8_IMPLEMENTATION
+
+#endif // UTF8_H
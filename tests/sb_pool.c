@@ -0,0 +1,128 @@
+// Regression tests for the per-thread buffer pool.
+//
+//     cc -std=c11 -pthread -o sb_pool_test tests/sb_pool.c && ./sb_pool_test
+
+#define _GNU_SOURCE
+#define SB_IMPLEMENTATION
+#include "../src/sb.h"
+#define SB_POOL_IMPLEMENTATION
+#include "../src/sb_pool.h"
+
+#include <assert.h>
+#include <pthread.h>
+
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned long long next(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+// Checks that a zeroing builder's buffer is zero past its contents.
+static void check_zero_tail(const string_builder *sb) {
+	if (sb->flags & SB_NOZERO) { return; }
+	for (size_t i = sb->len; i < sb->cap; i++) {
+		assert(sb->buf[i] == 0);
+	}
+}
+
+// Acquires and releases builders of random sizes and flags, leaving random
+// contents behind, so every buffer is recycled many times.
+static void test_random(void) {
+	char chunk[4096];
+	memset(chunk, 'x', sizeof(chunk));
+	string_builder live[16] = {0};
+	bool used[16] = {false};
+	for (int it = 0; it < 20000; it++) {
+		const unsigned i = next() % 16;
+		if (used[i]) {
+			sb_pool_release(&live[i]);
+			assert(live[i].buf == NULL);
+			used[i] = false;
+			continue;
+		}
+		const size_t cap = (size_t)1 << (next() % 18);
+		const unsigned flags = next() % 4 == 0 ? SB_NOZERO : 0;
+		sb_pool_acquire(&live[i], cap, flags);
+		assert(live[i].buf != NULL && live[i].cap >= cap && live[i].len == 0);
+		check_zero_tail(&live[i]);
+		size_t n = next() % (2 * cap);
+		while (n > 0) {
+			const size_t m = n < sizeof(chunk) ? n : sizeof(chunk);
+			sb_writen(&live[i], chunk, m);
+			n -= m;
+		}
+		if (next() % 3 == 0) {
+			sb_clear(&live[i]);
+		}
+		check_zero_tail(&live[i]);
+		used[i] = true;
+	}
+	for (unsigned i = 0; i < 16; i++) {
+		if (used[i]) {
+			sb_pool_release(&live[i]);
+		}
+	}
+	sb_pool_trim();
+}
+
+static pthread_key_t late_key;
+
+// Runs after the pool's own key destructor, since its key was created later.
+static void release_late(void *p) {
+	string_builder *sb = (string_builder *)p;
+	sb_pool_release(sb);
+	free(sb);
+}
+
+static void *exit_with_builder(void *arg) {
+	(void)arg;
+	string_builder *sb = (string_builder *)malloc(sizeof(*sb));
+	sb_pool_acquire(sb, 1000, 0);
+	sb_write(sb, "released at thread exit");
+	// Give the thread a pool before the builder is handed to the late key.
+	string_builder warm;
+	sb_pool_acquire(&warm, 100, 0);
+	sb_pool_release(&warm);
+	pthread_setspecific(late_key, sb);
+	return NULL;
+}
+
+// Releasing from a later key's destructor must not touch the freed pool.
+static void test_release_at_exit(void) {
+	// The pool's key is created on first use, before `late_key`.
+	string_builder sb;
+	sb_pool_acquire(&sb, 64, 0);
+	sb_pool_release(&sb);
+	assert(pthread_key_create(&late_key, release_late) == 0);
+	for (int i = 0; i < 8; i++) {
+		pthread_t t;
+		assert(pthread_create(&t, NULL, exit_with_builder, NULL) == 0);
+		assert(pthread_join(t, NULL) == 0);
+	}
+	pthread_key_delete(late_key);
+}
+
+// A buffer released with contents comes back zero past `len`.
+static void test_reacquire_zeroed(void) {
+	string_builder sb;
+	sb_pool_acquire(&sb, 512, 0);
+	sb_write(&sb, "some contents that must not come back");
+	char *buf = sb.buf;
+	sb_pool_release(&sb);
+	sb_pool_acquire(&sb, 512, 0);
+	assert(sb.buf == buf);
+	check_zero_tail(&sb);
+	sb_pool_release(&sb);
+	sb_pool_trim();
+}
+
+int main(void) {
+	test_random();
+	test_release_at_exit();
+	test_reacquire_zeroed();
+	puts("ok");
+	return 0;
+}
@@ -0,0 +1,63 @@
+// Regression tests for the concurrent string builder.
+//
+//     cc -std=c11 -o sb_shared_test tests/sb_shared.c && ./sb_shared_test
+
+#define _GNU_SOURCE
+#define SB_IMPLEMENTATION
+#define SB_SHARED_IMPLEMENTATION
+#include "../src/sb_shared.h"
+
+#include <assert.h>
+
+// A reservation that does not fit must not hold back the committed bytes
+// after the last full block.
+static void test_failed_reserve(void) {
+	static char chunk[5000];
+	memset(chunk, 'x', sizeof(chunk));
+	sb_shared s;
+	assert(sb_shared_init(&s, 8192));
+	assert(sb_shared_write(&s, chunk, sizeof(chunk)) == sizeof(chunk));
+	assert(sb_shared_write(&s, chunk, sizeof(chunk)) == 0);
+	assert(sb_shared_pending(&s).len == sizeof(chunk));
+	// What still fits is written after the failure.
+	assert(sb_shared_write(&s, chunk, 3000) == 3000);
+	assert(sb_shared_pending(&s).len == 8000);
+	sb_shared_deinit(&s);
+}
+
+// A region that is filled to the byte drains completely.
+static void test_exact_fill(void) {
+	static char chunk[SB_SHARED_BLOCK];
+	memset(chunk, 'y', sizeof(chunk));
+	sb_shared s;
+	assert(sb_shared_init(&s, 2 * SB_SHARED_BLOCK));
+	assert(sb_shared_write(&s, chunk, sizeof(chunk)) == sizeof(chunk));
+	assert(sb_shared_write(&s, chunk, sizeof(chunk)) == sizeof(chunk));
+	assert(sb_shared_write(&s, chunk, 1) == 0);
+	assert(sb_shared_pending(&s).len == 2 * SB_SHARED_BLOCK);
+	sb_shared_deinit(&s);
+}
+
+// Reset starts over with empty block counters.
+static void test_reset(void) {
+	sb_shared s;
+	assert(sb_shared_init(&s, 0));
+	assert(sb_shared_writef(&s, "%d", 42) == 2);
+	sb_slice p = sb_shared_pending(&s);
+	assert(p.len == 2 && memcmp(p.ptr, "42", 2) == 0);
+	sb_shared_consume(&s, p.len);
+	sb_shared_reset(&s);
+	assert(sb_shared_pending(&s).len == 0);
+	assert(sb_shared_write(&s, "ab", 2) == 2);
+	p = sb_shared_pending(&s);
+	assert(p.len == 2 && memcmp(p.ptr, "ab", 2) == 0);
+	sb_shared_deinit(&s);
+}
+
+int main(void) {
+	test_failed_reserve();
+	test_exact_fill();
+	test_reset();
+	puts("ok");
+	return 0;
+}